@@ -7,6 +7,8 @@ macro(simple_calculator_setup_options)
   # NOTE: enable hardening may cause build failed in debug mode
   option(simple_calculator_ENABLE_HARDENING "Enable hardening" OFF)
   option(simple_calculator_ENABLE_COVERAGE "Enable coverage reporting" OFF)
+  # NOTE: adds timers and counters to the lexer, parser and evaluator hot paths
+  option(simple_calculator_ENABLE_INSTRUMENTATION "Enable calculator hot-path instrumentation" OFF)
   cmake_dependent_option(
     simple_calculator_ENABLE_GLOBAL_HARDENING
     "Attempt to push hardening options to built dependencies"
@@ -100,8 +100,16 @@ function(
     # TODO support Intel compiler
   endif()
 
-  # use the same warning flags for C
-  set(PROJECT_WARNINGS_C "${PROJECT_WARNINGS_CXX}")
+  # use the same warning flags for C, minus the ones GCC rejects for C sources
+  set(PROJECT_WARNINGS_C ${PROJECT_WARNINGS_CXX})
+  list(
+    REMOVE_ITEM
+    PROJECT_WARNINGS_C
+    -Wnon-virtual-dtor
+    -Wold-style-cast
+    -Woverloaded-virtual
+    -Wuseless-cast
+    -Wsuggest-override)
 
   set(PROJECT_WARNINGS_CUDA "${CUDA_WARNINGS}")
 
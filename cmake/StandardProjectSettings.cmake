@@ -50,7 +50,7 @@ elseif(CMAKE_CXX_COMPILER_ID STREQUAL "GNU")
     add_compile_options($<$<COMPILE_LANGUAGE:C>:-fdiagnostics-color=always>
                         $<$<COMPILE_LANGUAGE:CXX>:-fdiagnostics-color=always>)
   else()
-    add_compile_options(-fdiagnostics-color=always -fdiagnostics-show-template-tree)
+    add_compile_options(-fdiagnostics-color=always $<$<COMPILE_LANGUAGE:CXX>:-fdiagnostics-show-template-tree>)
   endif()
 elseif(CMAKE_CXX_COMPILER_ID STREQUAL "MSVC")
   # Set encoding to UTF-8 to prevent MSVC from using the system code page
@@ -1,22 +1,56 @@
-#include <fmt/format.h>
-#include <iterator>
-#include <utility>
+#include "harness.hpp"
 
-[[nodiscard]] auto sum_values(const uint8_t *Data, size_t Size)
-{
-  constexpr auto scale = 1000;
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <string_view>
 
-  int value = 0;
-  for (std::size_t offset = 0; offset < Size; ++offset) {
-    value += static_cast<int>(*std::next(Data, static_cast<long>(offset))) * scale;
-  }
-  return value;
-}
+// libFuzzer 提供的字节级变异，作为语法变异之外的补充
+extern "C" size_t LLVMFuzzerMutate( uint8_t* Data, size_t Size, size_t MaxSize );
 
-// Fuzzer that attempts to invoke undefined behavior for signed integer overflow
+// 解析与求值的模糊测试。除崩溃外，解析或求值耗时相对输入长度超线性增长的输入也视为发现：
+// 打印后 abort，由 libFuzzer 保存为 crash-* 文件，可用 -minimize_crash=1 最小化，
+// 最小化后的输入放入 regressions/ 作为回归基准
 // cppcheck-suppress unusedFunction symbolName=LLVMFuzzerTestOneInput
-extern "C" int LLVMFuzzerTestOneInput(const uint8_t *Data, size_t Size)
-{
-  fmt::print("Value sum: {}, len{}\n", sum_values(Data, Size), Size);
-  return 0;
+extern "C" int LLVMFuzzerTestOneInput( const uint8_t* Data, size_t Size ) {
+    static const fuzz::Budget budget;
+    std::string_view input( reinterpret_cast< const char* >( Data ), Size );
+    auto result = fuzz::run( input );
+    if ( budget.exceeded( input, result.elapsed ) ) {
+        std::fprintf( stderr, "slow input: %zu bytes took %lld ns (limit %lld ns)\n", Size,
+                      static_cast< long long >( result.elapsed.count() ),
+                      static_cast< long long >( budget.limit( Size ).count() ) );
+        std::abort();
+    }
+    return 0;
+}
+
+// cppcheck-suppress unusedFunction symbolName=LLVMFuzzerCustomMutator
+extern "C" size_t LLVMFuzzerCustomMutator( uint8_t* Data, size_t Size, size_t MaxSize, unsigned int Seed ) {
+    // 四分之一的概率退回字节级变异，保留发现词法边界问题的能力
+    if ( Seed % 4 == 0 )
+        return LLVMFuzzerMutate( Data, Size, MaxSize );
+    fuzz::Generator generator( Seed );
+    std::string mutated = generator.mutate( std::string( reinterpret_cast< const char* >( Data ), Size ) );
+    if ( mutated.size() > MaxSize )
+        mutated.resize( MaxSize );
+    std::memcpy( Data, mutated.data(), mutated.size() );
+    return mutated.size();
+}
+
+// cppcheck-suppress unusedFunction symbolName=LLVMFuzzerCustomCrossOver
+extern "C" size_t LLVMFuzzerCustomCrossOver( const uint8_t* Data1, size_t Size1, const uint8_t* Data2, size_t Size2,
+                                             uint8_t* Out, size_t MaxOutSize, unsigned int Seed ) {
+    // 用运算符把两个输入的片段拼成一个表达式
+    static constexpr std::string_view operators = "+-*/^%";
+    std::string out( reinterpret_cast< const char* >( Data1 ), Size1 / 2 + Seed % ( Size1 / 2 + 1 ) );
+    out += operators[ Seed % operators.size() ];
+    out.append( reinterpret_cast< const char* >( Data2 ), Size2 / 2 );
+    if ( out.size() > MaxOutSize )
+        out.resize( MaxOutSize );
+    std::memcpy( Out, out.data(), out.size() );
+    return out.size();
 }
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <simple_calculator/calculator.hpp>
+#include <simple_calculator/numeric.hpp>
+#include <string>
+#include <string_view>
+
+// fuzz_tester 与 fuzz_regressions 共用的求值入口、耗时预算和表达式生成器
+
+namespace fuzz {
+
+    using Clock = std::chrono::steady_clock;
+
+    // 超过该长度的输入不再跑批量求值，避免单个样本拖慢整轮
+    constexpr std::size_t MAX_BATCH_INPUT = 4096;
+    // 单字节耗时超过线性基准的倍数，且总耗时超过 MIN_FINDING 时视为病态输入
+    constexpr double SLOWDOWN_FACTOR                 = 64;
+    constexpr std::chrono::nanoseconds MIN_FINDING   = std::chrono::milliseconds( 1 );
+    constexpr std::size_t CALIBRATION_TERMS          = 512;
+    constexpr std::array< double, 5 > BATCH_SAMPLES{ -2.5, -1, 0, 0.5, 3 };
+
+    struct RunResult {
+        bool parsed    = false;
+        bool evaluated = false;
+        double value   = 0;
+        std::chrono::nanoseconds elapsed{ 0 };
+    };
+
+    // 解析并求值一段输入：先按脚本(可含 x 和赋值语句)标量求值，再把单个表达式编译为批量程序，
+    // 检查批量结果与标量结果一致
+    inline RunResult run( std::string_view input ) {
+        RunResult result;
+        auto start = Clock::now();
+        Script script( { "x" } );
+        std::size_t x = *script.slotOf( "x" );
+        try {
+            script.compile( std::string( input ) );
+            result.parsed = true;
+            script.set( x, BATCH_SAMPLES[ 0 ] );
+            result.value     = script.run();
+            result.evaluated = true;
+        }
+        catch ( const std::runtime_error& ) {
+        }
+
+        if ( result.parsed && input.size() <= MAX_BATCH_INPUT ) {
+            try {
+                UnivariateFunction f( std::string( input ), "x" );
+                std::array< double, BATCH_SAMPLES.size() > ys{};
+                std::array< EvalStatus, BATCH_SAMPLES.size() > status{};
+                f.evaluate( BATCH_SAMPLES, ys, status.data() );
+                for ( std::size_t i = 0; i < BATCH_SAMPLES.size(); ++i ) {
+                    script.set( x, BATCH_SAMPLES[ i ] );
+                    double scalar = 0;
+                    bool ok       = true;
+                    try {
+                        scalar = script.run();
+                    }
+                    catch ( const std::runtime_error& ) {
+                        ok = false;
+                    }
+                    bool agree = ok == ( status[ i ] == EvalStatus::OK );
+                    if ( agree && ok && !( std::isnan( scalar ) && std::isnan( ys[ i ] ) ) && scalar != ys[ i ] )
+                        agree = std::abs( scalar - ys[ i ] ) <= 1e-9 * std::max( std::abs( scalar ), 1.0 );
+                    if ( !agree ) {
+                        std::fprintf( stderr, "scalar and batch evaluation disagree at x=%g: %.17g (%s) vs %.17g (%s)\n",
+                                      BATCH_SAMPLES[ i ], scalar, ok ? "ok" : "error", ys[ i ],
+                                      evalStatusMessage( status[ i ] ) );
+                        std::abort();
+                    }
+                }
+            }
+            catch ( const std::runtime_error& ) {
+                // 脚本语句(含 ; 或 =)不能编译为单个批量表达式
+            }
+        }
+        result.elapsed = std::chrono::duration_cast< std::chrono::nanoseconds >( Clock::now() - start );
+        return result;
+    }
+
+    // 耗时预算：以 1+1+...+1 的单字节耗时为线性基准，
+    // 输入的单字节耗时远超基准说明解析或求值随输入规模超线性增长
+    class Budget {
+        double nanosecondsPerByte = 0;
+
+    public:
+        Budget() {
+            std::string baseline = "1";
+            for ( std::size_t i = 1; i < CALIBRATION_TERMS; ++i )
+                baseline += "+1";
+            auto best = std::chrono::nanoseconds::max();
+            for ( int i = 0; i < 5; ++i )
+                best = std::min( best, run( baseline ).elapsed );
+            nanosecondsPerByte = static_cast< double >( best.count() ) / static_cast< double >( baseline.size() );
+        }
+
+        [[nodiscard]] std::chrono::nanoseconds limit( std::size_t size ) const {
+            auto scaled = SLOWDOWN_FACTOR * nanosecondsPerByte * static_cast< double >( std::max< std::size_t >( size, 1 ) );
+            return std::max( MIN_FINDING, std::chrono::nanoseconds( static_cast< std::int64_t >( scaled ) ) );
+        }
+
+        // 超出预算时重跑两次取最快的一次，排除调度抖动
+        [[nodiscard]] bool exceeded( std::string_view input, std::chrono::nanoseconds elapsed ) const {
+            auto bound = limit( input.size() );
+            for ( int retry = 0; retry < 2 && elapsed > bound; ++retry )
+                elapsed = std::min( elapsed, run( input ).elapsed );
+            return elapsed > bound;
+        }
+    };
+
+    // 按计算器语法生成“大致合法”的表达式，深度受限；
+    // 会有意生成深层括号、连续的 ^ 和大参数的 ! 等容易触发超线性行为的结构
+    class Generator {
+        std::mt19937 random;
+
+        std::size_t pick( std::size_t n ) {
+            return std::uniform_int_distribution< std::size_t >( 0, n - 1 )( random );
+        }
+
+        std::string number() {
+            static constexpr std::array< const char*, 12 > numbers{ "0",   "1",   "2",   "0.5", "3.14159", "10",
+                                                                    "170", "171", "1e3", "1.5", "100000",  "." };
+            return numbers[ pick( numbers.size() ) ];
+        }
+
+    public:
+        explicit Generator( unsigned int seed ) : random( seed ) {}
+
+        std::string expression( int depth ) {
+            if ( depth <= 0 ) {
+                switch ( pick( 4 ) ) {
+                case 0:
+                    return "x";
+                case 1:
+                    return pick( 2 ) == 0 ? "pi" : "e";
+                default:
+                    return number();
+                }
+            }
+            static constexpr std::array< const char*, 6 > binary{ "+", "-", "*", "/", "^", "%" };
+            static constexpr std::array< const char*, 7 > unary{ "sqrt", "sin", "cos", "tan", "lg", "ln", "abs" };
+            static constexpr std::array< const char*, 6 > comparison{ "<", "<=", ">", ">=", "==", "!=" };
+            switch ( pick( 9 ) ) {
+            case 0:
+                return "(" + expression( depth - 1 ) + ")";
+            case 1:
+                return unary[ pick( unary.size() ) ] + std::string( "(" ) + expression( depth - 1 ) + ")";
+            case 2:
+                return expression( depth - 1 ) + "!";
+            case 3:
+                return "-" + expression( depth - 1 );
+            case 4: {
+                // 深层括号
+                std::size_t nesting = 1 + pick( 64 );
+                return std::string( nesting, '(' ) + expression( depth - 1 ) + std::string( nesting, ')' );
+            }
+            case 5: {
+                // 连续的 ^
+                std::string chain = expression( depth - 1 );
+                for ( std::size_t i = pick( 16 ); i > 0; --i )
+                    chain += "^" + number();
+                return chain;
+            }
+            case 6: {
+                // 条件和分段函数：未选中分支的错误在标量和批量求值中都必须被丢弃
+                std::string condition = expression( depth - 1 ) + comparison[ pick( comparison.size() ) ]
+                                        + expression( depth - 1 );
+                switch ( pick( 3 ) ) {
+                case 0:
+                    return "if(" + condition + "," + expression( depth - 1 ) + "," + expression( depth - 1 ) + ")";
+                case 1:
+                    return "clamp(" + expression( depth - 1 ) + "," + expression( depth - 1 ) + ","
+                           + expression( depth - 1 ) + ")";
+                default:
+                    return std::string( pick( 2 ) == 0 ? "min(" : "max(" ) + expression( depth - 1 ) + ","
+                           + expression( depth - 1 ) + ")";
+                }
+            }
+            default:
+                return expression( depth - 1 ) + binary[ pick( binary.size() ) ] + expression( depth - 1 );
+            }
+        }
+
+        // 结构化变异：替换、插入子表达式、加括号/函数调用、复制片段(制造嵌套和长链)
+        std::string mutate( std::string input ) {
+            if ( input.empty() )
+                return expression( 4 );
+            std::size_t a = pick( input.size() + 1 );
+            std::size_t b = pick( input.size() + 1 );
+            if ( a > b )
+                std::swap( a, b );
+            switch ( pick( 5 ) ) {
+            case 0:
+                return expression( 1 + static_cast< int >( pick( 5 ) ) );
+            case 1:
+                return input.insert( a, expression( 2 ) + "+" );
+            case 2:
+                input.insert( b, ")" );
+                return input.insert( a, pick( 2 ) == 0 ? "(" : "sqrt(" );
+            case 3:
+                return input.insert( a, input.substr( a, b - a ) );
+            default:
+                return input.insert( b, pick( 2 ) == 0 ? "!" : "^" + number() );
+            }
+        }
+    };
+
+}  // namespace fuzz
@@ -0,0 +1,51 @@
+#include "harness.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <fmt/format.h>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// 回归基准：逐个运行 regressions/ 下由模糊测试发现并最小化的输入，
+// 输出耗时的中位数，任何一个超出耗时预算或崩溃即失败
+int main( int argc, char* argv[] ) {
+    if ( argc < 2 ) {
+        fmt::print( stderr, "usage: {} <regressions directory> [repeats]\n", argv[ 0 ] );
+        return 2;
+    }
+    const std::size_t repeats = argc > 2 ? std::max< std::size_t >( std::stoul( argv[ 2 ] ), 1 ) : 21;
+
+    std::vector< std::filesystem::path > files;
+    for ( const auto& entry : std::filesystem::directory_iterator( argv[ 1 ] ) )
+        if ( entry.is_regular_file() )
+            files.push_back( entry.path() );
+    std::sort( files.begin(), files.end() );
+
+    const fuzz::Budget budget;
+    int failures = 0;
+    for ( const auto& file : files ) {
+        std::ifstream in( file, std::ios::binary );
+        std::ostringstream contents;
+        contents << in.rdbuf();
+        const std::string input = contents.str();
+
+        std::vector< std::chrono::nanoseconds > times;
+        fuzz::RunResult result;
+        for ( std::size_t i = 0; i < repeats; ++i ) {
+            result = fuzz::run( input );
+            times.push_back( result.elapsed );
+        }
+        std::nth_element( times.begin(), times.begin() + static_cast< std::ptrdiff_t >( times.size() / 2 ), times.end() );
+        auto median = times[ times.size() / 2 ];
+        bool slow   = budget.exceeded( input, median );
+        failures += slow ? 1 : 0;
+        fmt::print( "{:<28} {:>7} bytes {:>12} ns/run {:>10.1f} ns/byte  {}{}\n", file.filename().string(),
+                    input.size(), median.count(),
+                    static_cast< double >( median.count() ) / static_cast< double >( std::max< std::size_t >( input.size(), 1 ) ),
+                    result.parsed ? ( result.evaluated ? "evaluated" : "rejected at evaluation" ) : "rejected at parse",
+                    slow ? "  SLOW" : "" );
+    }
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <simple_calculator/calculator_export.hpp>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class ASTNode;
+
+// 批量求值指令集：AST 被编译成后序的栈式指令序列，每条指令一次处理一整块(BATCH_BLOCK 个)样本，
+// 内层循环是简单的逐元素运算，便于编译器向量化
+// clang-format off
+enum class OpCode : std::uint8_t {
+    // 入栈：常量、输入列、标量子表达式(每次求值只计算一次后广播)
+    PUSH_CONST, PUSH_COLUMN, PUSH_CALL,
+    // 二元运算，弹出两个操作数压入结果
+    ADD, SUB, MUL, DIV, POW, MOD,
+    // 一元函数，原地改写栈顶
+    SQRT, SIN, COS, TAN, LG, LN, FACTORIAL,
+    // 比较(结果为 1 或 0)和逐元素的 min、max，弹出两个操作数压入结果
+    LT, LE, GT, GE, EQ, NE, MIN, MAX,
+    // 一元函数
+    ABS,
+    // 弹出 cond、a、b 三个操作数，逐元素按 cond != 0 选择 a 或 b，同时丢弃未选中一侧的错误
+    SELECT,
+};
+
+// 逐元素的求值状态，与标量 evaluate() 抛出的错误一一对应
+enum class EvalStatus : std::uint8_t {
+    OK,
+    DIVISION_BY_ZERO, MODULO_BY_ZERO, SQRT_NEGATIVE, TAN_UNDEFINED,
+    LG_NON_POSITIVE, LN_NON_POSITIVE, FACTORIAL_NEGATIVE, FACTORIAL_NON_INTEGER,
+};
+// clang-format on
+
+[[nodiscard]] CALCULATOR_EXPORT const char* evalStatusMessage( EvalStatus status );
+
+// 逐元素运算错误：标量求值和不带状态缓冲区的批量求值都抛出它，信息为 evalStatusMessage(status())；
+// 继承 runtime_error，需要与批量状态对照的调用方可以单独捕获并读取 status()
+class CALCULATOR_EXPORT EvaluationError : public std::runtime_error {
+    EvalStatus code;
+
+public:
+    explicit EvaluationError( EvalStatus status ) : std::runtime_error( evalStatusMessage( status ) ), code( status ) {}
+    [[nodiscard]] EvalStatus status() const {
+        return code;
+    }
+};
+
+// 固定 16 字节、不含指针，可以直接写入文件或内存映射
+struct Instruction {
+    OpCode op;
+    std::uint8_t reserved[ 3 ] = {};
+    std::uint32_t operand      = 0;  // PUSH_COLUMN 的列号或 PUSH_CALL 的下标
+    double immediate           = 0;  // PUSH_CONST 的值
+};
+static_assert( sizeof( Instruction ) == 16 );
+
+// 一列输入：第 i 个样本位于 data[i * stride]，stride 为 0 表示把同一个标量广播到所有样本
+struct Column {
+    const double* data;
+    std::ptrdiff_t stride = 1;
+};
+
+inline constexpr std::size_t BATCH_BLOCK = 256;
+
+struct BatchProgram {
+    std::vector< Instruction > code;
+    // 输入列名，PUSH_COLUMN 的 operand 是此处的下标
+    std::vector< std::string > columns;
+    // 由数组变量引入的列对应的数据源，预先声明的列为 nullptr
+    std::vector< const std::span< const double >* > sources;
+    // PUSH_CALL 引用的标量子树，程序不能比 AST 活得更久
+    std::vector< const ASTNode* > calls;
+    std::uint32_t maxDepth = 0;
+};
+
+// 不拥有指令的只读程序视图，可以指向 BatchProgram，也可以直接指向内存映射的公式包
+struct ProgramView {
+    std::span< const Instruction > code;
+    std::uint32_t maxDepth = 0;
+};
+
+class CALCULATOR_EXPORT BatchCompiler {
+    BatchProgram program;
+    std::uint32_t depth = 0;
+
+    void push();
+
+public:
+    explicit BatchCompiler( std::vector< std::string > columns = {} );
+
+    [[nodiscard]] std::optional< std::uint32_t > findColumn( const std::string& name ) const;
+    // 预先声明的输入列(不含数组变量引入的列)
+    [[nodiscard]] std::vector< std::string > inputColumns() const;
+    std::uint32_t addColumn( const std::string& name, const std::span< const double >* source = nullptr );
+
+    void emitConstant( double value );
+    void emitColumn( std::uint32_t column );
+    void emitCall( const ASTNode& node );
+    void emit( OpCode op );
+
+    BatchProgram finish();
+};
+
+// 把 root 编译为批量程序；columns 中的名字按顺序成为输入列，其余变量按标量处理
+CALCULATOR_EXPORT BatchProgram compileBatch( const ASTNode& root, std::vector< std::string > columns = {} );
+
+// 常量折叠：操作数全是常量的运算在编译期算出，结果与运行时逐条执行完全一致；
+// 会出错的运算(例如除以常量 0)原样保留，错误仍在求值时报告
+CALCULATOR_EXPORT void foldConstants( BatchProgram& program );
+
+// 执行程序的第 [offset, offset + count) 个样本，PUSH_CALL 的值从 callValues 读取；
+// 错误处理与 BatchEvaluator::run 相同。inputs 至少要覆盖程序用到的所有列
+CALCULATOR_EXPORT void runProgram( ProgramView program, std::span< const Column > inputs,
+                                   std::span< const double > callValues, std::size_t offset, std::size_t count,
+                                   double* out, EvalStatus* status = nullptr );
+// 单精度版本：常量、输入列和 PUSH_CALL 的值入栈时舍入为 float，之后的运算全部按 float 进行，
+// 内层循环的向量宽度加倍、栈的内存流量减半。factorial 在 35 以上溢出为 inf
+CALCULATOR_EXPORT void runProgram( ProgramView program, std::span< const Column > inputs,
+                                   std::span< const double > callValues, std::size_t offset, std::size_t count,
+                                   float* out, EvalStatus* status = nullptr );
+// 第 i 个结果写入 out[i * outStride]，供按行存储的调用方直接写到目标位置
+CALCULATOR_EXPORT void runProgram( ProgramView program, std::span< const Column > inputs,
+                                   std::span< const double > callValues, std::size_t offset, std::size_t count,
+                                   double* out, std::ptrdiff_t outStride, EvalStatus* status );
+
+// 一次批量求值的上下文：构造时计算所有 PUSH_CALL 的值，之后 run() 可以在多个线程上并发调用。
+// PUSH_CALL 的求值错误不在构造时抛出，而是记为该值的状态，像逐元素错误一样只在被选中的行上报告
+class CALCULATOR_EXPORT BatchEvaluator {
+    const BatchProgram& program;
+    std::vector< Column > inputs;
+    std::vector< double > callValues;
+    std::vector< EvalStatus > callStatus;
+
+public:
+    BatchEvaluator( const BatchProgram& prog, std::span< const Column > columns );
+
+    // 求值第 [offset, offset + count) 个样本写入 out；
+    // status 为空时遇到任何错误都抛出 std::runtime_error，否则逐元素写入状态且出错位置的结果为 NaN
+    void run( std::size_t offset, std::size_t count, double* out, EvalStatus* status = nullptr ) const;
+    // 按 float 求值，错误处理相同
+    void run( std::size_t offset, std::size_t count, float* out, EvalStatus* status = nullptr ) const;
+};
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <simple_calculator/calculator_export.hpp>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+class ASTNode;
+
+// 不可信表达式的资源预算：输入长度、token 数、嵌套深度、静态估计的代价和求值的墙钟时限。
+// 除时限外都在真正求值之前检查，超出预算的请求不会占用实际的计算时间
+
+enum class BudgetError { INPUT_TOO_LARGE, TOO_MANY_TOKENS, TOO_DEEP, TOO_EXPENSIVE, DEADLINE_EXCEEDED };
+
+[[nodiscard]] CALCULATOR_EXPORT const char* budgetErrorName( BudgetError error );
+
+// 超出预算时抛出；继承 runtime_error，只关心成败的调用方无需修改，
+// 需要区分“表达式错误”与“超出预算”的调用方可以单独捕获并读取 code()
+class CALCULATOR_EXPORT BudgetExceeded : public std::runtime_error {
+    BudgetError error;
+
+public:
+    BudgetExceeded( BudgetError e, const std::string& message ) : std::runtime_error( message ), error( e ) {}
+    [[nodiscard]] BudgetError code() const {
+        return error;
+    }
+};
+
+struct ResourceBudget {
+    std::size_t maxInputBytes = 64 * 1024;
+    std::size_t maxTokens     = 16 * 1024;
+    std::size_t maxDepth      = 256;  // 嵌套深度，同时限制求值的递归深度；左结合的长链条迭代展开，长度只受 token 数限制
+    double maxCost            = 1e7;
+    std::chrono::milliseconds deadline{ 100 };
+};
+
+// 静态代价模型，在解析之后、求值之前计算
+struct ExpressionCost {
+    std::size_t nodes          = 0;
+    std::size_t depth          = 0;  // 嵌套深度，同一优先级的左结合链条(a + b + c + ...)只算一层
+    double factorialIterations = 0;  // 阶乘循环的最坏迭代次数
+    double transcendentalCalls = 0;  // sin/cos/tan/lg/ln/pow 的调用次数(聚合函数按数组长度计)
+    double cost                = 0;  // 加权总代价，约等于基本算术运算的次数
+};
+
+// 各类运算相对于一次加法的代价权重
+namespace cost_weight {
+    constexpr double ARITHMETIC     = 1;
+    constexpr double SQRT           = 4;
+    constexpr double TRANSCENDENTAL = 20;
+    // 171! 已溢出为 inf，阶乘循环最多 170 次
+    constexpr double MAX_FACTORIAL_ITERATIONS = 170;
+}  // namespace cost_weight
+
+// 由 ASTNode::estimate 驱动的代价累加器。聚合函数的 body 用单独的累加器估计，
+// 逐元素部分乘以数组长度，内部嵌套的聚合(按标量广播，只算一次)不乘
+class CALCULATOR_EXPORT CostEstimator {
+    ExpressionCost own;     // 本累加器中每次(每个元素)都会执行的部分
+    ExpressionCost nested;  // 已合并的嵌套聚合，只执行一次
+    std::size_t level  = 0;
+    std::size_t length = 0;  // 本累加器中见到的最长数组
+    bool chained       = false;
+    std::vector< bool > frames;  // 每个尚未离开的节点是否延续了父节点的链条
+
+public:
+    // 进入/离开一个节点，统计节点数和深度
+    void enter();
+    void leave();
+    // 下一个进入的节点延续当前节点的同优先级链条，不增加深度
+    void continueChain();
+
+    // 权重不低于 TRANSCENDENTAL 的运算同时计为一次超越函数调用
+    void operation( double weight );
+    void factorial( double iterations );
+    void array( std::size_t size );
+    // 合并一个聚合函数 body 的估计结果
+    void aggregate( const CostEstimator& body );
+
+    [[nodiscard]] ExpressionCost result() const;
+};
+
+[[nodiscard]] CALCULATOR_EXPORT ExpressionCost estimateCost( const ASTNode& root );
+
+// 检查静态代价，超出深度或代价预算时抛出 BudgetExceeded
+CALCULATOR_EXPORT ExpressionCost checkBudget( const ASTNode& root, const ResourceBudget& budget );
+
+// 按预算解析并求值：依次检查输入长度、token 数(词法分析时)、深度和代价，最后在时限内求值
+[[nodiscard]] CALCULATOR_EXPORT double evaluateWithBudget(
+    const std::string& input, const ResourceBudget& budget,
+    const std::function< std::unique_ptr< ASTNode >( const std::string& ) >& resolver = {} );
+
+// 求值时限，作用于当前线程；嵌套时取较早的时限。
+// 求值中的长循环(批量求值的每个块、聚合的每个分块和脚本的每条语句)调用 checkDeadline() 协作检查
+class CALCULATOR_EXPORT DeadlineScope {
+    std::optional< std::chrono::steady_clock::time_point > previous;
+
+public:
+    explicit DeadlineScope( std::chrono::nanoseconds timeout );
+    // 把调用线程的时限传给线程池中的工作线程
+    explicit DeadlineScope( std::optional< std::chrono::steady_clock::time_point > deadline );
+    ~DeadlineScope();
+    DeadlineScope( const DeadlineScope& )            = delete;
+    DeadlineScope& operator=( const DeadlineScope& ) = delete;
+};
+
+[[nodiscard]] CALCULATOR_EXPORT std::optional< std::chrono::steady_clock::time_point > currentDeadline();
+// 超过当前线程的时限时抛出 BudgetExceeded(DEADLINE_EXCEEDED)
+CALCULATOR_EXPORT void checkDeadline();
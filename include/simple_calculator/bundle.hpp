@@ -0,0 +1,102 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <simple_calculator/batch.hpp>
+#include <simple_calculator/calculator_export.hpp>
+#include <simple_calculator/mapped_file.hpp>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+// 预编译公式包：把解析并编译好的批量指令连同名字索引写成一个与地址无关的二进制文件。
+// 加载时直接 mmap，按名字 O(1) 查找并在映射的内存上求值，没有反序列化，也没有逐公式的堆分配。
+//
+// 文件布局(小端，各段 16 字节对齐，位置都是相对文件开头的偏移)：
+//   文件头 | 公式目录 | 名字哈希表 | 指令 | 列名引用 | 字符串池
+// 文件头、目录与哈希表、其余数据各有一个校验和，文件中的每个字节都被覆盖
+
+inline constexpr std::uint32_t BUNDLE_VERSION = 1;
+
+// 打开时的校验范围：INDEX 只校验文件头、目录和哈希表，代价与公式数成正比而与指令总量无关，
+// 每个公式的指令结构推迟到它第一次被 find()/at() 取出时检查，代价与该公式的长度成正比；
+// FULL 在打开时额外校验指令段以后的全部数据和每个公式的指令结构，用于来源不可信或可能损坏的文件
+enum class BundleCheck { INDEX, FULL };
+
+class CALCULATOR_EXPORT BundleWriter {
+    struct Formula {
+        std::string name;
+        std::vector< std::string > columns;
+        std::vector< Instruction > code;
+        std::uint32_t maxDepth;
+    };
+    std::vector< Formula > formulas;
+    std::unordered_set< std::string > names;
+    bool fold;
+
+public:
+    explicit BundleWriter( bool foldConstants = true ) : fold( foldConstants ) {}
+
+    // 解析并编译一个公式，其中的自由变量按首次出现的顺序成为输入列
+    void add( const std::string& name, const std::string& expression );
+    // 加入已编译的程序；含 PUSH_CALL 或数组列的程序依赖进程内的 AST，不能写入文件
+    void add( const std::string& name, const BatchProgram& program );
+
+    [[nodiscard]] std::size_t size() const {
+        return formulas.size();
+    }
+    [[nodiscard]] std::vector< std::byte > serialize() const;
+    void write( const std::string& path ) const;
+};
+
+// 公式包中的一个公式，只是指向映射内存的视图，不能比 FormulaBundle 活得更久
+class CALCULATOR_EXPORT BundleFormula {
+    const std::byte* base;
+    const void* entry;
+
+public:
+    BundleFormula( const std::byte* data, const void* formulaEntry ) : base( data ), entry( formulaEntry ) {}
+
+    [[nodiscard]] std::string_view name() const;
+    [[nodiscard]] std::size_t columnCount() const;
+    [[nodiscard]] std::string_view column( std::size_t i ) const;
+    [[nodiscard]] ProgramView program() const;
+
+    // 批量求值，columns 按 column(i) 的顺序给出
+    void evaluate( std::span< const Column > columns, std::size_t offset, std::size_t count, double* out,
+                   EvalStatus* status = nullptr ) const;
+    // 标量求值，args 按 column(i) 的顺序给出；出错时抛出 std::runtime_error
+    double operator()( std::span< const double > args = {} ) const;
+};
+
+class CALCULATOR_EXPORT FormulaBundle {
+    MappedFile file;  // view() 时为空
+    const std::byte* data = nullptr;
+    std::size_t length    = 0;
+    std::unique_ptr< std::atomic< bool >[] > validated;  // INDEX 校验时每个公式的指令是否已检查，FULL 时为空
+
+    FormulaBundle( MappedFile mapped, std::span< const std::byte > bytes, BundleCheck check );
+    // 取出第 i 个公式，首次取出时检查它的指令结构
+    [[nodiscard]] BundleFormula checked( std::size_t i ) const;
+
+public:
+    // 以只读方式 mmap 文件；格式、版本、长度或校验和不符时抛出 std::runtime_error，
+    // INDEX 校验下指令损坏的公式在 at()/find() 取出时抛出
+    static FormulaBundle open( const std::string& path, BundleCheck check = BundleCheck::INDEX );
+    // 使用调用方持有的内存(例如嵌入程序的数据)，内存必须 16 字节对齐且比 FormulaBundle 活得更久
+    static FormulaBundle view( std::span< const std::byte > bytes, BundleCheck check = BundleCheck::INDEX );
+
+    FormulaBundle( FormulaBundle&& other ) noexcept;
+    FormulaBundle& operator=( FormulaBundle&& other ) noexcept;
+    FormulaBundle( const FormulaBundle& )            = delete;
+    FormulaBundle& operator=( const FormulaBundle& ) = delete;
+
+    [[nodiscard]] std::size_t size() const;
+    [[nodiscard]] BundleFormula at( std::size_t i ) const;
+    [[nodiscard]] std::optional< BundleFormula > find( std::string_view name ) const;
+};
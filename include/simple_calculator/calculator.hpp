@@ -1,16 +1,47 @@
+#pragma once
+
+#include <algorithm>
 #include <cctype>
 #include <cmath>
 #include <format>
+#include <functional>
+#include <limits>
 #include <memory>
 #include <numbers>
+#include <optional>
+#include <simple_calculator/batch.hpp>
+#include <simple_calculator/budget.hpp>
+#include <simple_calculator/instrumentation.hpp>
+#include <simple_calculator/parallel.hpp>
+#include <simple_calculator/token_buffer.hpp>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 class ASTNode {
 public:
+    ASTNode() {
+        CALC_COUNT_NODE();
+    }
     virtual ~ASTNode()                            = default;
     [[nodiscard]] virtual double evaluate() const = 0;
+    // 编译为批量求值指令；默认把整棵子树当作标量，每次批量求值只计算一次再广播
+    virtual void compile( BatchCompiler& compiler ) const {
+        compiler.emitCall( *this );
+    }
+    // 静态代价估计；默认按一个无子节点的基本运算计
+    virtual void estimate( CostEstimator& estimator ) const {
+        estimator.enter();
+        estimator.operation( cost_weight::ARITHMETIC );
+        estimator.leave();
+    }
+    // 并行求值的规划；默认把整棵子树当作不可拆分的叶子
+    virtual void plan( ParallelPlanner& planner ) const {
+        planner.leaf( *this );
+    }
 };
 
 class NumberNode : public ASTNode {
@@ -19,25 +50,187 @@ class NumberNode : public ASTNode {
 public:
     explicit NumberNode( double val ) : value( val ) {}
     [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( NUMBER );
         return value;
     }
+    void compile( BatchCompiler& compiler ) const override {
+        compiler.emitConstant( value );
+    }
+    [[nodiscard]] double getValue() const {
+        return value;
+    }
+};
+
+// 命名变量：求值时读取外部持有的存储位置，由解析时的 Parser::Resolver 绑定
+class VariableNode : public ASTNode {
+    std::string name;
+    const double* slot;
+
+public:
+    VariableNode( std::string n, const double* s ) : name( std::move( n ) ), slot( s ) {}
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( VARIABLE );
+        return *slot;
+    }
+    // 批量求值时若同名输入列存在则逐元素读取，否则按标量广播
+    void compile( BatchCompiler& compiler ) const override {
+        if ( auto column = compiler.findColumn( name ) )
+            compiler.emitColumn( *column );
+        else
+            compiler.emitCall( *this );
+    }
+    [[nodiscard]] const std::string& getName() const {
+        return name;
+    }
+};
+
+// 脚本寄存器：编译期把变量名解析为寄存器编号，求值时按下标直接读取
+class SlotNode : public ASTNode {
+    const std::vector< double >& registers;
+    std::size_t index;
+
+public:
+    SlotNode( const std::vector< double >& regs, std::size_t i ) : registers( regs ), index( i ) {}
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( SLOT );
+        return registers[ index ];
+    }
+    [[nodiscard]] std::size_t getIndex() const {
+        return index;
+    }
 };
 
+// 解析器的循环会产生很长的左深链条(a + b + c + ...)，逐层递归会耗尽调用栈：
+// 析构、求值、编译和代价估计都沿左侧迭代展开，递归深度只取决于嵌套层数
 class BinaryOpNode : public ASTNode {
 protected:
     std::unique_ptr< ASTNode > left;
     std::unique_ptr< ASTNode > right;
+    const BinaryOpNode* leftChain;  // 左操作数也是二元运算时指向它，否则为空
 
 public:
     BinaryOpNode( std::unique_ptr< ASTNode > l, std::unique_ptr< ASTNode > r )
-        : left( std::move( l ) ), right( std::move( r ) ) {}
+        : left( std::move( l ) ), right( std::move( r ) ),
+          leftChain( dynamic_cast< const BinaryOpNode* >( left.get() ) ) {}
+    ~BinaryOpNode() override {
+        std::unique_ptr< ASTNode > next = std::move( left );
+        while ( auto* chain = dynamic_cast< BinaryOpNode* >( next.get() ) )
+            next = std::move( chain->left );
+    }
+    BinaryOpNode( const BinaryOpNode& )            = delete;
+    BinaryOpNode& operator=( const BinaryOpNode& ) = delete;
+
+    // 对已经求出的两个操作数做这一步运算，错误与 evaluate() 相同
+    [[nodiscard]] virtual double apply( double lhs, double rhs ) const = 0;
+
+    void compile( BatchCompiler& compiler ) const override {
+        std::vector< const BinaryOpNode* > spine;
+        const BinaryOpNode* node = this;
+        for ( ; node->leftChain; node = node->leftChain )
+            spine.push_back( node );
+        node->left->compile( compiler );
+        for ( ;; ) {
+            node->right->compile( compiler );
+            compiler.emit( node->opcode() );
+            if ( spine.empty() )
+                return;
+            node = spine.back();
+            spine.pop_back();
+        }
+    }
+    void estimate( CostEstimator& estimator ) const override {
+        std::vector< const BinaryOpNode* > spine;
+        const BinaryOpNode* node = this;
+        for ( ;; node = node->leftChain ) {
+            estimator.enter();
+            if ( !node->leftChain )
+                break;
+            if ( node->chain() != Chain::NONE && node->leftChain->chain() == node->chain() )
+                estimator.continueChain();
+            spine.push_back( node );
+        }
+        node->left->estimate( estimator );
+        for ( ;; ) {
+            node->right->estimate( estimator );
+            estimator.operation( node->weight() );
+            estimator.leave();
+            if ( spine.empty() )
+                return;
+            node = spine.back();
+            spine.pop_back();
+        }
+    }
+    void plan( ParallelPlanner& planner ) const override {
+        planner.binary( *this, *left, *right, ChainLink::NONE );
+    }
+
+protected:
+    // 解析器循环产生的同一优先级左结合链条(a + b - c、a * b / c、min(a, b, c))，代价估计中按一层嵌套计算深度
+    enum class Chain { NONE, ADDITIVE, MULTIPLICATIVE, MINIMUM, MAXIMUM };
+    [[nodiscard]] virtual Chain chain() const {
+        return Chain::NONE;
+    }
+    [[nodiscard]] virtual OpCode opcode() const = 0;
+    // 代价估计中这一步运算的权重
+    [[nodiscard]] virtual double weight() const {
+        return cost_weight::ARITHMETIC;
+    }
+
+    // 先左后右求出两个操作数再运算：与批量求值一样，两边都出错时报告左操作数的错误。
+    // 左操作数本身还有更长的左侧链条时迭代求值，链条内部的节点不单独计入性能统计
+    [[nodiscard]] double evaluateOperands() const {
+        double lhs = leftChain && leftChain->leftChain ? leftChain->evaluateChain() : left->evaluate();
+        return apply( lhs, right->evaluate() );
+    }
+
+private:
+    // 每个线程复用的链条展开空间，右操作数中嵌套的链条在其后追加，结束时恢复原长度
+    static std::vector< const BinaryOpNode* >& chainScratch() {
+        thread_local std::vector< const BinaryOpNode* > scratch;
+        return scratch;
+    }
+
+    [[nodiscard]] double evaluateChain() const {
+        std::vector< const BinaryOpNode* >& spine = chainScratch();
+        const std::size_t base                    = spine.size();
+        const BinaryOpNode* node                  = this;
+        for ( ; node->leftChain; node = node->leftChain )
+            spine.push_back( node );
+        try {
+            double value = node->left->evaluate();
+            for ( ;; ) {
+                value = node->apply( value, node->right->evaluate() );
+                if ( spine.size() == base )
+                    return value;
+                node = spine.back();
+                spine.pop_back();
+            }
+        }
+        catch ( ... ) {
+            spine.resize( base );
+            throw;
+        }
+    }
 };
 
 class AddNode : public BinaryOpNode {
 public:
     using BinaryOpNode::BinaryOpNode;
     [[nodiscard]] double evaluate() const override {
-        return left->evaluate() + right->evaluate();
+        CALC_PROFILE_NODE( ADD );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return lhs + rhs;
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::ADD;
+    }
+    void plan( ParallelPlanner& planner ) const override {
+        planner.binary( *this, *left, *right, ChainLink::ADD );
+    }
+    [[nodiscard]] Chain chain() const override {
+        return Chain::ADDITIVE;
     }
 };
 
@@ -45,7 +238,20 @@ class SubtractNode : public BinaryOpNode {
 public:
     using BinaryOpNode::BinaryOpNode;
     [[nodiscard]] double evaluate() const override {
-        return left->evaluate() - right->evaluate();
+        CALC_PROFILE_NODE( SUBTRACT );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return lhs - rhs;
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::SUB;
+    }
+    void plan( ParallelPlanner& planner ) const override {
+        planner.binary( *this, *left, *right, ChainLink::SUBTRACT );
+    }
+    [[nodiscard]] Chain chain() const override {
+        return Chain::ADDITIVE;
     }
 };
 
@@ -53,18 +259,47 @@ class MultiplyNode : public BinaryOpNode {
 public:
     using BinaryOpNode::BinaryOpNode;
     [[nodiscard]] double evaluate() const override {
-        return left->evaluate() * right->evaluate();
+        CALC_PROFILE_NODE( MULTIPLY );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return lhs * rhs;
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::MUL;
+    }
+    void plan( ParallelPlanner& planner ) const override {
+        planner.binary( *this, *left, *right, ChainLink::MULTIPLY );
+    }
+    [[nodiscard]] Chain chain() const override {
+        return Chain::MULTIPLICATIVE;
     }
 };
 
 class DivideNode : public BinaryOpNode {
+    static double checked( double denominator ) {
+        if ( denominator == 0 )
+            throw EvaluationError( EvalStatus::DIVISION_BY_ZERO );
+        return denominator;
+    }
+
 public:
     using BinaryOpNode::BinaryOpNode;
     [[nodiscard]] double evaluate() const override {
-        double denominator = right->evaluate();
-        if ( denominator == 0 )
-            throw std::runtime_error( "Division by zero" );
-        return left->evaluate() / denominator;
+        CALC_PROFILE_NODE( DIVIDE );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return lhs / checked( rhs );
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::DIV;
+    }
+    void plan( ParallelPlanner& planner ) const override {
+        planner.binary( *this, *left, *right, ChainLink::ORDERED );
+    }
+    [[nodiscard]] Chain chain() const override {
+        return Chain::MULTIPLICATIVE;
     }
 };
 
@@ -72,18 +307,173 @@ class PowerNode : public BinaryOpNode {
 public:
     using BinaryOpNode::BinaryOpNode;
     [[nodiscard]] double evaluate() const override {
-        return std::pow( left->evaluate(), right->evaluate() );
+        CALC_PROFILE_NODE( POWER );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return std::pow( lhs, rhs );
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::POW;
+    }
+    [[nodiscard]] double weight() const override {
+        return cost_weight::TRANSCENDENTAL;
     }
 };
 
 class ModuloNode : public BinaryOpNode {
+    static double checked( double divisor ) {
+        if ( divisor == 0 )
+            throw EvaluationError( EvalStatus::MODULO_BY_ZERO );
+        return divisor;
+    }
+
 public:
     using BinaryOpNode::BinaryOpNode;
     [[nodiscard]] double evaluate() const override {
-        double divisor = right->evaluate();
-        if ( divisor == 0 )
-            throw std::runtime_error( "Modulo by zero" );
-        return std::fmod( left->evaluate(), divisor );
+        CALC_PROFILE_NODE( MODULO );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return std::fmod( lhs, checked( rhs ) );
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::MOD;
+    }
+    void plan( ParallelPlanner& planner ) const override {
+        planner.binary( *this, *left, *right, ChainLink::ORDERED );
+    }
+    [[nodiscard]] Chain chain() const override {
+        return Chain::MULTIPLICATIVE;
+    }
+};
+
+// 比较运算：成立为 1，否则为 0；与 NaN 比较时只有 != 成立
+class LessNode : public BinaryOpNode {
+public:
+    using BinaryOpNode::BinaryOpNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( LESS );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return lhs < rhs ? 1.0 : 0.0;
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::LT;
+    }
+};
+
+class LessEqualNode : public BinaryOpNode {
+public:
+    using BinaryOpNode::BinaryOpNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( LESS_EQUAL );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return lhs <= rhs ? 1.0 : 0.0;
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::LE;
+    }
+};
+
+class GreaterNode : public BinaryOpNode {
+public:
+    using BinaryOpNode::BinaryOpNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( GREATER );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return lhs > rhs ? 1.0 : 0.0;
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::GT;
+    }
+};
+
+class GreaterEqualNode : public BinaryOpNode {
+public:
+    using BinaryOpNode::BinaryOpNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( GREATER_EQUAL );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return lhs >= rhs ? 1.0 : 0.0;
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::GE;
+    }
+};
+
+class EqualNode : public BinaryOpNode {
+public:
+    using BinaryOpNode::BinaryOpNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( EQUAL );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return lhs == rhs ? 1.0 : 0.0;
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::EQ;
+    }
+};
+
+class NotEqualNode : public BinaryOpNode {
+public:
+    using BinaryOpNode::BinaryOpNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( NOT_EQUAL );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return lhs != rhs ? 1.0 : 0.0;
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::NE;
+    }
+};
+
+// 两个值中较小/较大的一个，即 std::min/std::max：两者相等或有 NaN 时返回左操作数。
+// 多参数的 min(a, b, c) 解析为左深链条；单参数的 min(array) 是聚合函数 MinNode
+class MinimumNode : public BinaryOpNode {
+public:
+    using BinaryOpNode::BinaryOpNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( MINIMUM );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return std::min( lhs, rhs );
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::MIN;
+    }
+    [[nodiscard]] Chain chain() const override {
+        return Chain::MINIMUM;
+    }
+};
+
+class MaximumNode : public BinaryOpNode {
+public:
+    using BinaryOpNode::BinaryOpNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( MAXIMUM );
+        return evaluateOperands();
+    }
+    [[nodiscard]] double apply( double lhs, double rhs ) const override {
+        return std::max( lhs, rhs );
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::MAX;
+    }
+    [[nodiscard]] Chain chain() const override {
+        return Chain::MAXIMUM;
     }
 };
 
@@ -93,24 +483,66 @@ protected:
 
 public:
     explicit UnaryFunctionNode( std::unique_ptr< ASTNode > op ) : operand( std::move( op ) ) {}
+
+    // 对已经求出的操作数求函数值，错误与 evaluate() 相同
+    [[nodiscard]] virtual double apply( double value ) const = 0;
+
+    void compile( BatchCompiler& compiler ) const override {
+        operand->compile( compiler );
+        compiler.emit( opcode() );
+    }
+    void estimate( CostEstimator& estimator ) const override {
+        estimateWith( estimator, cost_weight::ARITHMETIC );
+    }
+    void plan( ParallelPlanner& planner ) const override {
+        planner.unary( *this, *operand );
+    }
+
+protected:
+    [[nodiscard]] virtual OpCode opcode() const = 0;
+    void estimateWith( CostEstimator& estimator, double weight ) const {
+        estimator.enter();
+        operand->estimate( estimator );
+        estimator.operation( weight );
+        estimator.leave();
+    }
 };
 
 class SqrtNode : public UnaryFunctionNode {
 public:
     using UnaryFunctionNode::UnaryFunctionNode;
     [[nodiscard]] double evaluate() const override {
-        double val = operand->evaluate();
+        CALC_PROFILE_NODE( SQRT );
+        return apply( operand->evaluate() );
+    }
+    [[nodiscard]] double apply( double val ) const override {
         if ( val < 0 )
-            throw std::runtime_error( "Square root of negative number" );
+            throw EvaluationError( EvalStatus::SQRT_NEGATIVE );
         return std::sqrt( val );
     }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::SQRT;
+    }
+    void estimate( CostEstimator& estimator ) const override {
+        estimateWith( estimator, cost_weight::SQRT );
+    }
 };
 
 class SinNode : public UnaryFunctionNode {
 public:
     using UnaryFunctionNode::UnaryFunctionNode;
     [[nodiscard]] double evaluate() const override {
-        return std::sin( operand->evaluate() );
+        CALC_PROFILE_NODE( SIN );
+        return apply( operand->evaluate() );
+    }
+    [[nodiscard]] double apply( double val ) const override {
+        return std::sin( val );
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::SIN;
+    }
+    void estimate( CostEstimator& estimator ) const override {
+        estimateWith( estimator, cost_weight::TRANSCENDENTAL );
     }
 };
 
@@ -118,7 +550,17 @@ class CosNode : public UnaryFunctionNode {
 public:
     using UnaryFunctionNode::UnaryFunctionNode;
     [[nodiscard]] double evaluate() const override {
-        return std::cos( operand->evaluate() );
+        CALC_PROFILE_NODE( COS );
+        return apply( operand->evaluate() );
+    }
+    [[nodiscard]] double apply( double val ) const override {
+        return std::cos( val );
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::COS;
+    }
+    void estimate( CostEstimator& estimator ) const override {
+        estimateWith( estimator, cost_weight::TRANSCENDENTAL );
     }
 };
 
@@ -126,55 +568,262 @@ class TanNode : public UnaryFunctionNode {
 public:
     using UnaryFunctionNode::UnaryFunctionNode;
     [[nodiscard]] double evaluate() const override {
-        double val = operand->evaluate();
+        CALC_PROFILE_NODE( TAN );
+        return apply( operand->evaluate() );
+    }
+    [[nodiscard]] double apply( double val ) const override {
         if ( std::cos( val ) == 0 )  
-            throw std::runtime_error( "Tangent undefined (division by zero)" );
+            throw EvaluationError( EvalStatus::TAN_UNDEFINED );
         return std::tan( val );
     }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::TAN;
+    }
+    void estimate( CostEstimator& estimator ) const override {
+        estimateWith( estimator, cost_weight::TRANSCENDENTAL );
+    }
 };
 
 class LgNode : public UnaryFunctionNode {
 public:
     using UnaryFunctionNode::UnaryFunctionNode;
     [[nodiscard]] double evaluate() const override {
-        double val = operand->evaluate();
+        CALC_PROFILE_NODE( LG );
+        return apply( operand->evaluate() );
+    }
+    [[nodiscard]] double apply( double val ) const override {
         if ( val <= 0 )
-            throw std::runtime_error( "Logarithm of non-positive number" );
+            throw EvaluationError( EvalStatus::LG_NON_POSITIVE );
         return std::log10( val );
     }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::LG;
+    }
+    void estimate( CostEstimator& estimator ) const override {
+        estimateWith( estimator, cost_weight::TRANSCENDENTAL );
+    }
 };
 
 class LnNode : public UnaryFunctionNode {
 public:
     using UnaryFunctionNode::UnaryFunctionNode;
     [[nodiscard]] double evaluate() const override {
-        double val = operand->evaluate();
+        CALC_PROFILE_NODE( LN );
+        return apply( operand->evaluate() );
+    }
+    [[nodiscard]] double apply( double val ) const override {
         if ( val <= 0 )
-            throw std::runtime_error( "Natural logarithm of non-positive number" );
+            throw EvaluationError( EvalStatus::LN_NON_POSITIVE );
         return std::log( val );
     }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::LN;
+    }
+    void estimate( CostEstimator& estimator ) const override {
+        estimateWith( estimator, cost_weight::TRANSCENDENTAL );
+    }
 };
 
 class FactorialNode : public UnaryFunctionNode {
 public:
     using UnaryFunctionNode::UnaryFunctionNode;
     [[nodiscard]] double evaluate() const override {
-        double val = operand->evaluate();
+        CALC_PROFILE_NODE( FACTORIAL );
+        return apply( operand->evaluate() );
+    }
+    [[nodiscard]] double apply( double val ) const override {
         // Factorial is only defined for non-negative integers
         if ( val < 0 )
-            throw std::runtime_error( "Factorial of negative number" );
+            throw EvaluationError( EvalStatus::FACTORIAL_NEGATIVE );
 
-        // Check if the value is very close to an integer
+        // Check if the value is very close to an integer (NaN is not)
         double intPart;
-        if ( std::abs( std::modf( val, &intPart ) ) > 1e-10 )
-            throw std::runtime_error( "Factorial only defined for non-negative integers" );
+        if ( std::isnan( val ) || std::abs( std::modf( val, &intPart ) ) > 1e-10 )
+            throw EvaluationError( EvalStatus::FACTORIAL_NON_INTEGER );
+        // 171! 已超出 double 范围，不必再逐项相乘(否则 1e9! 要循环十亿次)
+        if ( intPart > 170 )
+            return std::numeric_limits< double >::infinity();
 
-        auto n        = static_cast< unsigned int >( intPart );
+        auto n       = static_cast< unsigned int >( intPart );
         double result = 1.0;
         for ( unsigned int i = 2; i <= n; ++i )
             result *= i;
         return result;
     }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::FACTORIAL;
+    }
+    // 操作数为常量时按实际迭代次数计，否则按最坏情况计
+    void estimate( CostEstimator& estimator ) const override {
+        double iterations = cost_weight::MAX_FACTORIAL_ITERATIONS;
+        if ( const auto* number = dynamic_cast< const NumberNode* >( operand.get() ) )
+            iterations = std::clamp( number->getValue(), 0.0, cost_weight::MAX_FACTORIAL_ITERATIONS );
+        estimator.enter();
+        operand->estimate( estimator );
+        estimator.factorial( iterations );
+        estimator.leave();
+    }
+};
+
+class AbsNode : public UnaryFunctionNode {
+public:
+    using UnaryFunctionNode::UnaryFunctionNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( ABS );
+        return apply( operand->evaluate() );
+    }
+    [[nodiscard]] double apply( double val ) const override {
+        return std::abs( val );
+    }
+    [[nodiscard]] OpCode opcode() const override {
+        return OpCode::ABS;
+    }
+};
+
+inline void ParallelPlanner::unary( const UnaryFunctionNode& node, const ASTNode& operand ) {
+    current = Shape{ Kind::UNARY, &node, { &operand, nullptr }, ChainLink::NONE };
+}
+
+inline void ParallelPlanner::binary( const BinaryOpNode& node, const ASTNode& left, const ASTNode& right,
+                                     ChainLink link ) {
+    current = Shape{ Kind::BINARY, &node, { &left, &right }, link };
+}
+
+// if(cond, a, b)：cond 不为 0(NaN 也算不为 0)时取 a，否则取 b。
+// 标量求值只计算选中的分支，未选中分支的代价和错误(例如 x <= 0 时的 ln(x))都不会发生；
+// 批量求值时两个分支都计算，由 SELECT 逐元素选择，未选中分支的错误随之丢弃。
+// 并行求值把整个 if 当作叶子，保持只计算一个分支
+class IfNode : public ASTNode {
+    std::unique_ptr< ASTNode > condition;
+    std::unique_ptr< ASTNode > whenTrue;
+    std::unique_ptr< ASTNode > whenFalse;
+
+public:
+    IfNode( std::unique_ptr< ASTNode > c, std::unique_ptr< ASTNode > a, std::unique_ptr< ASTNode > b )
+        : condition( std::move( c ) ), whenTrue( std::move( a ) ), whenFalse( std::move( b ) ) {}
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( IF );
+        return condition->evaluate() != 0 ? whenTrue->evaluate() : whenFalse->evaluate();
+    }
+    void compile( BatchCompiler& compiler ) const override {
+        condition->compile( compiler );
+        whenTrue->compile( compiler );
+        whenFalse->compile( compiler );
+        compiler.emit( OpCode::SELECT );
+    }
+    // 两个分支都计入：批量求值确实两个都算，对标量求值是上界
+    void estimate( CostEstimator& estimator ) const override {
+        estimator.enter();
+        condition->estimate( estimator );
+        whenTrue->estimate( estimator );
+        whenFalse->estimate( estimator );
+        estimator.operation( cost_weight::ARITHMETIC );
+        estimator.leave();
+    }
+};
+
+// 数组变量：只能出现在聚合函数内部，批量求值时作为输入列逐元素读取
+class ArrayVariableNode : public ASTNode {
+    std::string name;
+    const std::span< const double >* array;
+
+public:
+    ArrayVariableNode( std::string n, const std::span< const double >* a ) : name( std::move( n ) ), array( a ) {}
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( ARRAY_VARIABLE );
+        throw std::runtime_error( "Array '" + name + "' can only be used inside an aggregate function" );
+    }
+    void compile( BatchCompiler& compiler ) const override {
+        compiler.emitColumn( compiler.addColumn( name, array ) );
+    }
+    void estimate( CostEstimator& estimator ) const override {
+        estimator.enter();
+        estimator.operation( cost_weight::ARITHMETIC );
+        estimator.array( array->size() );
+        estimator.leave();
+    }
+};
+
+// 聚合函数基类：构造时把 body 编译为批量程序，求值时在绑定的数组上分块求值并归约。
+// 归约按固定大小分块，块内使用多路 Kahan 补偿求和，块间两两(pairwise)合并，
+// 因此无论用多少线程结果都完全一致
+class AggregateNode : public ASTNode {
+protected:
+    enum class Reduction { SUM, MIN, MAX };
+
+    std::unique_ptr< ASTNode > body;
+    BatchProgram program;
+
+    // 返回归约结果，count 为参与归约的元素个数；实现见 aggregate.cpp
+    [[nodiscard]] double reduce( Reduction reduction, std::size_t& count ) const;
+
+public:
+    explicit AggregateNode( std::unique_ptr< ASTNode > b );
+    // 聚合结果对外层批量求值的每个样本都相同，按标量广播；body 依赖外层输入列时报错
+    void compile( BatchCompiler& compiler ) const override;
+    // 逐元素代价乘以数组长度
+    void estimate( CostEstimator& estimator ) const override;
+};
+
+class SumNode : public AggregateNode {
+public:
+    using AggregateNode::AggregateNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( SUM );
+        std::size_t count = 0;
+        return reduce( Reduction::SUM, count );
+    }
+};
+
+class MeanNode : public AggregateNode {
+public:
+    using AggregateNode::AggregateNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( MEAN );
+        std::size_t count = 0;
+        double sum        = reduce( Reduction::SUM, count );
+        if ( count == 0 )
+            throw std::runtime_error( "Mean of empty array" );
+        return sum / static_cast< double >( count );
+    }
+};
+
+class MinNode : public AggregateNode {
+public:
+    using AggregateNode::AggregateNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( MIN );
+        std::size_t count = 0;
+        double result     = reduce( Reduction::MIN, count );
+        if ( count == 0 )
+            throw std::runtime_error( "Minimum of empty array" );
+        return result;
+    }
+};
+
+class MaxNode : public AggregateNode {
+public:
+    using AggregateNode::AggregateNode;
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( MAX );
+        std::size_t count = 0;
+        double result     = reduce( Reduction::MAX, count );
+        if ( count == 0 )
+            throw std::runtime_error( "Maximum of empty array" );
+        return result;
+    }
+};
+
+// dot(a, b) 即 sum(a * b)，乘法在同一个批量程序里完成，不产生中间数组
+class DotNode : public AggregateNode {
+public:
+    DotNode( std::unique_ptr< ASTNode > a, std::unique_ptr< ASTNode > b )
+        : AggregateNode( std::make_unique< MultiplyNode >( std::move( a ), std::move( b ) ) ) {}
+    [[nodiscard]] double evaluate() const override {
+        CALC_PROFILE_NODE( DOT );
+        std::size_t count = 0;
+        return reduce( Reduction::SUM, count );
+    }
 };
 
 // clang-format off
@@ -184,12 +833,22 @@ enum class TokenType {
     // 运算符+,-,*,/,^,%,!
     OP_PLUS,OP_MINUS,OP_MUL,OP_DIV,
     OP_POW, OP_MOD,OP_FACTORIAL,
+    // 比较运算符<,<=,>,>=,==,!=
+    OP_LT,OP_LE,OP_GT,OP_GE,OP_EQ,OP_NE,
     // 左右括号
     LPAREN,RPAREN,
     // 函数sqrt,sin,cos,tan,lg,ln
     FUNC_SQRT,FUNC_SIN,FUNC_COS,FUNC_TAN,FUNC_LG,FUNC_LN,
+    // 条件与分段函数if,abs,clamp
+    FUNC_IF,FUNC_ABS,FUNC_CLAMP,
+    // 聚合函数sum,mean,min,max,dot及参数分隔符,
+    FUNC_SUM,FUNC_MEAN,FUNC_MIN,FUNC_MAX,FUNC_DOT,COMMA,
     // 常量pi,e
     CONST_PI,CONST_E,
+    // 标识符(变量名或公式名)
+    IDENTIFIER,
+    // 语句分隔符;和赋值=
+    SEMICOLON,ASSIGN,
     // 结束标志
     END
 };
@@ -197,24 +856,92 @@ enum class TokenType {
 
 struct Token {
     TokenType type;
-    double value;  // 仅当type为NUMBER时有效
+    double value;      // 仅当type为NUMBER时有效
+    std::string name;  // 仅当type为IDENTIFIER时有效
     explicit Token( TokenType t ) : type( t ), value( 0 ) {}
     explicit Token( double v ) : type( TokenType::NUMBER ), value( v ) {}
+    explicit Token( std::string n ) : type( TokenType::IDENTIFIER ), value( 0 ), name( std::move( n ) ) {}
 };
 
+// STREAMING 逐字符扫描；BULK 构造时用 tokenize() 一次扫描整个输入，之后从 token 缓冲区读取；
+// AUTO 对超过 BULK_THRESHOLD 字节的输入使用 BULK
+enum class LexMode { AUTO, STREAMING, BULK };
+
 class Lexer {
+    static constexpr size_t BULK_THRESHOLD = 4096;
+
     std::string input;
-    size_t pos = 0;
+    size_t pos        = 0;  // 批量模式下为下一个 token 的下标
+    size_t tokens     = 0;
+    size_t tokenLimit = std::numeric_limits< size_t >::max();
+    std::optional< TokenBuffer > buffer;
+    size_t number = 0;  // 批量模式下下一个数字在 buffer->values 中的下标
 
     void skipWhitespace() {
         while ( pos < input.size() && std::isspace( input[ pos ] ) )
             pos++;
     }
 
+    // 下一个字符是 next 时跳过它并返回 true，用于识别 <=、>=、==、!=
+    bool follows( char next ) {
+        if ( pos < input.size() && input[ pos ] == next ) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+
+    Token nextBuffered() {
+        if ( pos >= buffer->size() ) {
+            if ( buffer->failed )
+                throw std::runtime_error( buffer->error );
+            return Token( TokenType::END );
+        }
+        size_t index = pos++;
+        switch ( buffer->type( index ) ) {
+        case TokenType::NUMBER:
+            return Token( buffer->values[ number++ ] );
+        case TokenType::IDENTIFIER:
+            CALC_COUNT_ALLOCATION();
+            return Token( input.substr( buffer->offsets[ index ], buffer->lengths[ index ] ) );
+        default:
+            return Token( buffer->type( index ) );
+        }
+    }
+
 public:
-    explicit Lexer( std::string str ) : input( std::move( str ) ) {}
+    explicit Lexer( std::string str, LexMode mode = LexMode::AUTO ) : input( std::move( str ) ) {
+        if ( mode == LexMode::BULK || ( mode == LexMode::AUTO && input.size() > BULK_THRESHOLD ) ) {
+            CALC_PROFILE_PHASE( LEX );
+            buffer = tokenize( input );
+        }
+    }
+
+    // 超过 limit 个 token 时 nextToken() 抛出 BudgetExceeded(TOO_MANY_TOKENS)
+    void limitTokens( size_t limit ) {
+        tokenLimit = limit;
+    }
+
+    // 预读下一个 token，不移动读取位置
+    Token peekToken() {
+        size_t saved       = pos;
+        size_t savedTokens = tokens;
+        size_t savedNumber = number;
+        Token token        = nextToken();
+        pos                = saved;
+        tokens             = savedTokens;
+        number             = savedNumber;
+        return token;
+    }
 
     Token nextToken() {
+        CALC_PROFILE_PHASE_UNTRACED( LEX );
+        CALC_COUNT_TOKEN();
+        if ( ++tokens > tokenLimit )
+            throw BudgetExceeded( BudgetError::TOO_MANY_TOKENS,
+                                  std::format( "Input exceeds the limit of {} tokens", tokenLimit ) );
+        if ( buffer )
+            return nextBuffered();
         skipWhitespace();
         if ( pos >= input.size() )
             return Token( TokenType::END );
@@ -224,14 +951,26 @@ public:
             size_t start = pos - 1;
             while ( pos < input.size() && ( std::isdigit( input[ pos ] ) || input[ pos ] == '.' ) )
                 pos++;
-            return Token( std::stod( input.substr( start, pos - start ) ) );
+            CALC_COUNT_ALLOCATION();
+            std::string text = input.substr( start, pos - start );
+            // std::stod 对 "." 和溢出抛出 logic_error 系列异常，统一转换为 runtime_error
+            try {
+                return Token( std::stod( text ) );
+            }
+            catch ( const std::out_of_range& ) {
+                throw std::runtime_error( "Number out of range: " + text );
+            }
+            catch ( const std::invalid_argument& ) {
+                throw std::runtime_error( "Invalid number: " + text );
+            }
         }
 
-        if ( std::isalpha( c ) ) {
+        if ( std::isalpha( c ) || c == '_' ) {
             size_t start = pos - 1;
-            while ( pos < input.size() && std::isalpha( input[ pos ] ) ) {
+            while ( pos < input.size() && ( std::isalnum( input[ pos ] ) || input[ pos ] == '_' ) ) {
                 pos++;
             }
+            CALC_COUNT_ALLOCATION();
             std::string identifier = input.substr( start, pos - start );
             if ( identifier == "sqrt" )
                 return Token( TokenType::FUNC_SQRT );
@@ -245,11 +984,28 @@ public:
                 return Token( TokenType::FUNC_LG );
             if ( identifier == "ln" )
                 return Token( TokenType::FUNC_LN );
+            if ( identifier == "sum" )
+                return Token( TokenType::FUNC_SUM );
+            if ( identifier == "mean" )
+                return Token( TokenType::FUNC_MEAN );
+            if ( identifier == "min" )
+                return Token( TokenType::FUNC_MIN );
+            if ( identifier == "max" )
+                return Token( TokenType::FUNC_MAX );
+            if ( identifier == "dot" )
+                return Token( TokenType::FUNC_DOT );
+            if ( identifier == "if" )
+                return Token( TokenType::FUNC_IF );
+            if ( identifier == "abs" )
+                return Token( TokenType::FUNC_ABS );
+            if ( identifier == "clamp" )
+                return Token( TokenType::FUNC_CLAMP );
             if ( identifier == "pi" )
                 return Token( TokenType::CONST_PI );
             if ( identifier == "e" )
                 return Token( TokenType::CONST_E );
-            throw std::runtime_error( "Unknown identifier: " + identifier );
+            // 其余名字交给 Parser 解析，由 Resolver 决定其含义
+            return Token( std::move( identifier ) );
         }
 
         switch ( c ) {
@@ -266,20 +1022,61 @@ public:
         case '%':
             return Token( TokenType::OP_MOD );
         case '!':
-            return Token( TokenType::OP_FACTORIAL );
+            return Token( follows( '=' ) ? TokenType::OP_NE : TokenType::OP_FACTORIAL );
+        case '<':
+            return Token( follows( '=' ) ? TokenType::OP_LE : TokenType::OP_LT );
+        case '>':
+            return Token( follows( '=' ) ? TokenType::OP_GE : TokenType::OP_GT );
         case '(':
             return Token( TokenType::LPAREN );
         case ')':
             return Token( TokenType::RPAREN );
+        case ',':
+            return Token( TokenType::COMMA );
+        case ';':
+            return Token( TokenType::SEMICOLON );
+        case '=':
+            return Token( follows( '=' ) ? TokenType::OP_EQ : TokenType::ASSIGN );
         default:
             throw std::runtime_error( "Invalid character: " + std::string( 1, c ) );
         }
     }
 };
 
+// 脚本中的一条语句：target 非空时为赋值语句 target = expression
+struct Statement {
+    std::string target;
+    std::unique_ptr< ASTNode > expression;
+};
+
 class Parser {
+public:
+    // 将标识符解析为 AST 节点；返回 nullptr 表示未知标识符
+    using Resolver = std::function< std::unique_ptr< ASTNode >( const std::string& ) >;
+
+private:
+    // 递归下降的嵌套层数上限(每层括号约占两层)，防止深层嵌套耗尽栈空间
+    static constexpr std::size_t MAX_NESTING = 1000;
+
     Lexer& lexer;
     Token currentToken;
+    Resolver resolver;
+    std::size_t nesting = 0;
+
+    class NestingGuard {
+        std::size_t& nesting;
+
+    public:
+        explicit NestingGuard( std::size_t& n ) : nesting( n ) {
+            if ( ++nesting > MAX_NESTING )
+                throw BudgetExceeded( BudgetError::TOO_DEEP, "Expression nested too deeply" );
+        }
+        ~NestingGuard() {
+            --nesting;
+        }
+        NestingGuard( const NestingGuard& )            = delete;
+        NestingGuard& operator=( const NestingGuard& ) = delete;
+    };
 
     void eat( TokenType expected ) {
         if ( currentToken.type == expected ) {
@@ -291,6 +1088,7 @@ class Parser {
     }
 
     std::unique_ptr< ASTNode > factor() {
+        NestingGuard guard( nesting );
         Token token = currentToken;
         if ( token.type == TokenType::NUMBER ) {
             eat( TokenType::NUMBER );
@@ -304,6 +1102,13 @@ class Parser {
             eat( TokenType::CONST_E );
             return std::make_unique< NumberNode >( std::numbers::e );
         }
+        else if ( token.type == TokenType::IDENTIFIER ) {
+            eat( TokenType::IDENTIFIER );
+            auto node = resolver ? resolver( token.name ) : nullptr;
+            if ( !node )
+                throw std::runtime_error( "Unknown identifier: " + token.name );
+            return node;
+        }
         else if ( token.type == TokenType::LPAREN ) {
             eat( TokenType::LPAREN );
             auto node = expression();
@@ -360,11 +1165,89 @@ class Parser {
             eat( TokenType::RPAREN );
             return std::make_unique< LnNode >( std::move( arg ) );
         }
+        else if ( token.type == TokenType::FUNC_SUM ) {
+            eat( TokenType::FUNC_SUM );
+            eat( TokenType::LPAREN );
+            auto arg = expression();
+            eat( TokenType::RPAREN );
+            return std::make_unique< SumNode >( std::move( arg ) );
+        }
+        else if ( token.type == TokenType::FUNC_MEAN ) {
+            eat( TokenType::FUNC_MEAN );
+            eat( TokenType::LPAREN );
+            auto arg = expression();
+            eat( TokenType::RPAREN );
+            return std::make_unique< MeanNode >( std::move( arg ) );
+        }
+        else if ( token.type == TokenType::FUNC_MIN ) {
+            return extremum< MinNode, MinimumNode >( TokenType::FUNC_MIN );
+        }
+        else if ( token.type == TokenType::FUNC_MAX ) {
+            return extremum< MaxNode, MaximumNode >( TokenType::FUNC_MAX );
+        }
+        else if ( token.type == TokenType::FUNC_DOT ) {
+            eat( TokenType::FUNC_DOT );
+            eat( TokenType::LPAREN );
+            auto lhs = expression();
+            eat( TokenType::COMMA );
+            auto rhs = expression();
+            eat( TokenType::RPAREN );
+            return std::make_unique< DotNode >( std::move( lhs ), std::move( rhs ) );
+        }
+        else if ( token.type == TokenType::FUNC_IF ) {
+            eat( TokenType::FUNC_IF );
+            eat( TokenType::LPAREN );
+            auto condition = expression();
+            eat( TokenType::COMMA );
+            auto whenTrue = expression();
+            eat( TokenType::COMMA );
+            auto whenFalse = expression();
+            eat( TokenType::RPAREN );
+            return std::make_unique< IfNode >( std::move( condition ), std::move( whenTrue ), std::move( whenFalse ) );
+        }
+        else if ( token.type == TokenType::FUNC_ABS ) {
+            eat( TokenType::FUNC_ABS );
+            eat( TokenType::LPAREN );
+            auto arg = expression();
+            eat( TokenType::RPAREN );
+            return std::make_unique< AbsNode >( std::move( arg ) );
+        }
+        else if ( token.type == TokenType::FUNC_CLAMP ) {
+            // clamp(x, lo, hi) 即 min(max(x, lo), hi)，lo > hi 时结果为 hi
+            eat( TokenType::FUNC_CLAMP );
+            eat( TokenType::LPAREN );
+            auto value = expression();
+            eat( TokenType::COMMA );
+            auto lower = expression();
+            eat( TokenType::COMMA );
+            auto upper = expression();
+            eat( TokenType::RPAREN );
+            return std::make_unique< MinimumNode >(
+                std::make_unique< MaximumNode >( std::move( value ), std::move( lower ) ), std::move( upper ) );
+        }
         throw std::runtime_error( "Invalid factor" );
     }
 
+    // min/max：单个参数时是数组上的聚合，两个及以上参数时逐个比较
+    template < typename Aggregate, typename Pairwise >
+    std::unique_ptr< ASTNode > extremum( TokenType function ) {
+        eat( function );
+        eat( TokenType::LPAREN );
+        auto node = expression();
+        if ( currentToken.type != TokenType::COMMA ) {
+            eat( TokenType::RPAREN );
+            return std::make_unique< Aggregate >( std::move( node ) );
+        }
+        while ( currentToken.type == TokenType::COMMA ) {
+            eat( TokenType::COMMA );
+            node = std::make_unique< Pairwise >( std::move( node ), expression() );
+        }
+        eat( TokenType::RPAREN );
+        return node;
+    }
+
     // INFO:优先级按照调用链排列，最先被调用的优先级最低，按照优先级从低到高排列如下:
-    // expression() → term() → power_expression() → factorial_expression() → factor()
+    // expression() → arithmetic_expression() → term() → power_expression() → factorial_expression() → factor()
     std::unique_ptr< ASTNode > factorial_expression() {
         auto node = factor();
         if ( currentToken.type == TokenType::OP_FACTORIAL ) {
@@ -375,6 +1258,7 @@ class Parser {
     }
 
     std::unique_ptr< ASTNode > power_expression() {
+        NestingGuard guard( nesting );
         auto node = factorial_expression();
         if ( currentToken.type == TokenType::OP_POW ) {
             eat( TokenType::OP_POW );
@@ -404,7 +1288,7 @@ class Parser {
         return node;
     }
 
-    std::unique_ptr< ASTNode > expression() {
+    std::unique_ptr< ASTNode > arithmetic_expression() {
         auto node = term();
         while ( currentToken.type == TokenType::OP_PLUS || currentToken.type == TokenType::OP_MINUS ) {
             Token op = currentToken;
@@ -420,10 +1304,43 @@ class Parser {
         return node;
     }
 
+    static bool isComparison( TokenType type ) {
+        return type == TokenType::OP_LT || type == TokenType::OP_LE || type == TokenType::OP_GT
+               || type == TokenType::OP_GE || type == TokenType::OP_EQ || type == TokenType::OP_NE;
+    }
+
+    // 比较运算的优先级最低且不能连写：a < b < c 是语法错误，需要写成 if 或加括号
+    std::unique_ptr< ASTNode > expression() {
+        auto node = arithmetic_expression();
+        if ( !isComparison( currentToken.type ) )
+            return node;
+        TokenType op = currentToken.type;
+        eat( op );
+        auto rhs = arithmetic_expression();
+        if ( isComparison( currentToken.type ) )
+            throw std::runtime_error( "Comparisons cannot be chained" );
+        switch ( op ) {
+        case TokenType::OP_LT:
+            return std::make_unique< LessNode >( std::move( node ), std::move( rhs ) );
+        case TokenType::OP_LE:
+            return std::make_unique< LessEqualNode >( std::move( node ), std::move( rhs ) );
+        case TokenType::OP_GT:
+            return std::make_unique< GreaterNode >( std::move( node ), std::move( rhs ) );
+        case TokenType::OP_GE:
+            return std::make_unique< GreaterEqualNode >( std::move( node ), std::move( rhs ) );
+        case TokenType::OP_EQ:
+            return std::make_unique< EqualNode >( std::move( node ), std::move( rhs ) );
+        default:
+            return std::make_unique< NotEqualNode >( std::move( node ), std::move( rhs ) );
+        }
+    }
+
 public:
     explicit Parser( Lexer& l ) : lexer( l ), currentToken( l.nextToken() ) {}
+    Parser( Lexer& l, Resolver r ) : lexer( l ), currentToken( l.nextToken() ), resolver( std::move( r ) ) {}
 
     std::unique_ptr< ASTNode > parse() {
+        CALC_PROFILE_PHASE( PARSE );
         // handle empty input
         if ( currentToken.type == TokenType::END ) {
             return std::make_unique< NumberNode >( NumberNode( 0 ) );
@@ -436,4 +1353,127 @@ public:
         }
         return node;
     }
+
+    [[nodiscard]] bool atEnd() const {
+        return currentToken.type == TokenType::END;
+    }
+
+    // 解析一条以 ; 或输入结束为止的语句：[IDENTIFIER =] expression [;]
+    Statement statement() {
+        CALC_PROFILE_PHASE( PARSE );
+        Statement stmt;
+        if ( currentToken.type == TokenType::IDENTIFIER && lexer.peekToken().type == TokenType::ASSIGN ) {
+            stmt.target = currentToken.name;
+            eat( TokenType::IDENTIFIER );
+            eat( TokenType::ASSIGN );
+        }
+        stmt.expression = expression();
+        if ( currentToken.type == TokenType::SEMICOLON )
+            eat( TokenType::SEMICOLON );
+        else if ( currentToken.type != TokenType::END )
+            throw std::runtime_error(
+                std::format( "Unexpected token after expression: {}", static_cast< int >( currentToken.type ) ) );
+        return stmt;
+    }
+};
+
+// 数组绑定：名字到外部数组的映射，数组本身由调用方持有。
+// 重新 bind 同名数组后，已解析的表达式在下一次求值时会读取新的数据
+class ArrayBindings {
+    std::unordered_map< std::string, std::span< const double > > arrays;
+
+public:
+    void bind( const std::string& name, std::span< const double > data ) {
+        arrays[ name ] = data;
+    }
+
+    // 供 Parser 使用的 Resolver；ArrayBindings 必须比解析出的 AST 活得更久
+    [[nodiscard]] Parser::Resolver resolver() const {
+        return [ this ]( const std::string& name ) -> std::unique_ptr< ASTNode > {
+            auto it = arrays.find( name );
+            if ( it == arrays.end() )
+                return nullptr;
+            return std::make_unique< ArrayVariableNode >( name, &it->second );
+        };
+    }
+};
+
+// 多语句脚本，例如 "a = sqrt(2); b = a*a + a; b / a"。
+// 变量在编译期被分配到编号寄存器，每个值只计算一次，求值时按下标读取，不做名字查找。
+class Script {
+    std::vector< double > registers;
+    std::unordered_map< std::string, std::size_t > slots;
+    std::size_t predefinedCount = 0;
+    std::vector< std::pair< std::optional< std::size_t >, std::unique_ptr< ASTNode > > > program;
+
+    std::size_t bind( const std::string& name ) {
+        auto it = slots.find( name );
+        if ( it != slots.end() )
+            return it->second;
+        registers.push_back( 0 );
+        slots.emplace( name, registers.size() - 1 );
+        return registers.size() - 1;
+    }
+
+public:
+    // predefined 中的变量(例如 GUI 的 Ans)在多次 compile 之间保留寄存器和值
+    explicit Script( const std::vector< std::string >& predefined = {} ) {
+        for ( const auto& name : predefined )
+            bind( name );
+        predefinedCount = registers.size();
+    }
+
+    // SlotNode 引用了 registers，禁止拷贝和移动
+    Script( const Script& )            = delete;
+    Script& operator=( const Script& ) = delete;
+
+    void compile( const std::string& source ) {
+        program.clear();
+        registers.resize( predefinedCount );
+        std::erase_if( slots, [ this ]( const auto& entry ) { return entry.second >= predefinedCount; } );
+
+        Lexer lexer( source );
+        Parser parser( lexer, [ this ]( const std::string& name ) -> std::unique_ptr< ASTNode > {
+            auto it = slots.find( name );
+            if ( it == slots.end() )
+                return nullptr;
+            return std::make_unique< SlotNode >( registers, it->second );
+        } );
+        while ( !parser.atEnd() ) {
+            Statement stmt = parser.statement();
+            // 先解析右值再绑定目标，因此 "a = a + 1" 要求 a 已经定义
+            std::optional< std::size_t > target;
+            if ( !stmt.target.empty() )
+                target = bind( stmt.target );
+            program.emplace_back( target, std::move( stmt.expression ) );
+        }
+    }
+
+    // 依次执行所有语句，返回最后一条语句的值；空脚本返回 0
+    double run() {
+        double result = 0;
+        for ( const auto& [ target, expression ] : program ) {
+            checkDeadline();
+            result = expression->evaluate();
+            if ( target )
+                registers[ *target ] = result;
+        }
+        return result;
+    }
+
+    [[nodiscard]] std::optional< std::size_t > slotOf( const std::string& name ) const {
+        auto it = slots.find( name );
+        if ( it == slots.end() )
+            return std::nullopt;
+        return it->second;
+    }
+    [[nodiscard]] std::size_t slotCount() const {
+        return registers.size();
+    }
+    [[nodiscard]] double get( std::size_t slot ) const {
+        return registers.at( slot );
+    }
+    void set( std::size_t slot, double value ) {
+        registers.at( slot ) = value;
+    }
 };
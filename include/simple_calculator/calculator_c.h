@@ -0,0 +1,80 @@
+#ifndef SIMPLE_CALCULATOR_CALCULATOR_C_H
+#define SIMPLE_CALCULATOR_CALCULATOR_C_H
+
+#include <simple_calculator/calculator_c_export.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// 计算器的 C ABI，供非 C++ 的服务嵌入。
+// 表达式编译一次得到不透明句柄，之后直接在调用方持有的 double 缓冲区上批量求值：
+// 输入和输出都支持步长，逐元素的错误码写入调用方提供的缓冲区，求值过程中不做堆分配也不复制输入。
+// 只增不改：已有的函数、结构体布局和错误码的数值不会改变，不兼容的修改会提高 SC_ABI_VERSION
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define SC_ABI_VERSION 1
+
+// 调用的返回值。1 ~ 8 同时是逐元素的错误码，写入 uint8_t 缓冲区
+typedef int32_t sc_status;
+enum {
+    SC_OK                    = 0,
+    SC_DIVISION_BY_ZERO      = 1,
+    SC_MODULO_BY_ZERO        = 2,
+    SC_SQRT_NEGATIVE         = 3,
+    SC_TAN_UNDEFINED         = 4,
+    SC_LG_NON_POSITIVE       = 5,
+    SC_LN_NON_POSITIVE       = 6,
+    SC_FACTORIAL_NEGATIVE    = 7,
+    SC_FACTORIAL_NON_INTEGER = 8,
+    // 以下只作为调用的返回值
+    SC_INVALID_ARGUMENT = 64,
+    SC_PARSE_ERROR      = 65,
+    SC_OUT_OF_MEMORY    = 66,
+    SC_INTERNAL_ERROR   = 67,
+};
+
+// 编译后的表达式。编译完成后不再改变，任意多个线程可以同时用同一个句柄调用 sc_evaluate；
+// sc_release 不能与该句柄上的其他调用同时进行
+typedef struct sc_expression sc_expression;
+
+// 一列输入：第 i 行位于 data[i * stride]，步长以元素计，为 0 时所有行共用 data[0]
+typedef struct sc_column {
+    const double* data;
+    ptrdiff_t stride;
+} sc_column;
+
+// 运行时库的 ABI 版本，与编译时的 SC_ABI_VERSION 比较即可发现不匹配
+CALCULATOR_C_EXPORT uint32_t sc_abi_version( void );
+
+// 错误码的英文说明，返回静态字符串
+CALCULATOR_C_EXPORT const char* sc_status_message( sc_status status );
+
+// 编译 source 的前 length 个字节。columns 中的名字按顺序成为输入列，下标与 sc_evaluate 的 inputs 对应；
+// 表达式中的其他标识符是编译错误。成功时 *out 为新句柄，失败时 *out 为 NULL，
+// error 非空时写入以 0 结尾、按 error_capacity 截断的错误信息。
+// token 数超过默认资源预算(budget.hpp 中的 ResourceBudget::maxTokens)或括号嵌套过深的表达式返回 SC_PARSE_ERROR
+CALCULATOR_C_EXPORT sc_status sc_compile( const char* source, size_t length, const char* const* columns,
+                                          size_t column_count, sc_expression** out, char* error,
+                                          size_t error_capacity );
+
+// 释放句柄，NULL 被忽略
+CALCULATOR_C_EXPORT void sc_release( sc_expression* expression );
+
+// 编译时声明的输入列数，sc_evaluate 至少要提供这么多列
+CALCULATOR_C_EXPORT size_t sc_column_count( const sc_expression* expression );
+
+// 求值 rows 行，第 i 行的结果写入 out[i * out_stride]。
+// element_status 非空时第 i 行的错误码写入 element_status[i]，出错行的结果为 NaN，只要参数正确就返回 SC_OK；
+// element_status 为空时在第一个出错的行停止并返回它的错误码，此前的行已经写入 out。
+// 每个线程第一次求值(或遇到更深的表达式)时会分配一次可复用的栈空间，之后的调用不做堆分配
+CALCULATOR_C_EXPORT sc_status sc_evaluate( const sc_expression* expression, const sc_column* inputs,
+                                           size_t input_count, size_t rows, double* out, ptrdiff_t out_stride,
+                                           uint8_t* element_status );
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <simple_calculator/calculator.hpp>
+#include <simple_calculator/calculator_export.hpp>
+#include <simple_calculator/thread_pool.hpp>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+// 命名公式图：公式之间可以按名字相互引用，修改输入后只重算其下游的公式。
+// 重算按拓扑层(wave)进行，同一层内的公式互不依赖，在线程池上并行求值。
+class CALCULATOR_EXPORT FormulaGraph {
+public:
+    struct Stats {
+        std::size_t lastRecomputed  = 0;  // 最近一次 recalculate() 实际重算的公式数
+        std::size_t lastWaves       = 0;  // 最近一次 recalculate() 的层数
+        std::size_t totalRecomputed = 0;  // 累计重算的公式数
+    };
+
+    explicit FormulaGraph( std::size_t threads = std::thread::hardware_concurrency() );
+    ~FormulaGraph();
+
+    FormulaGraph( const FormulaGraph& )            = delete;
+    FormulaGraph& operator=( const FormulaGraph& ) = delete;
+
+    // 设置(或新建)输入值，并将其下游公式标记为脏
+    void setInput( const std::string& name, double value );
+    // 定义(或重新定义)公式：只解析一次并记录依赖；形成循环引用时抛出异常且图保持不变
+    void define( const std::string& name, const std::string& formula );
+    // 按拓扑层重算所有脏公式
+    void recalculate();
+
+    [[nodiscard]] bool contains( const std::string& name ) const;
+    [[nodiscard]] bool isDirty( const std::string& name ) const;
+    // 读取结果；公式求值失败(或依赖失败)时抛出 std::runtime_error
+    [[nodiscard]] double value( const std::string& name ) const;
+    [[nodiscard]] const Stats& stats() const {
+        return statistics;
+    }
+
+private:
+    enum class Kind { UNDEFINED, INPUT, FORMULA };
+
+    struct Node {
+        std::string name;
+        Kind kind    = Kind::UNDEFINED;
+        double value = 0;
+        std::unique_ptr< ASTNode > ast;
+        std::vector< std::size_t > dependencies;
+        std::vector< std::size_t > dependents;
+        std::optional< std::string > error;
+        bool dirty = false;
+    };
+
+    // Node 地址保持稳定，VariableNode 直接指向 Node::value
+    std::vector< std::unique_ptr< Node > > nodes;
+    std::unordered_map< std::string, std::size_t > index;
+    std::vector< std::size_t > dirtyNodes;
+    ThreadPool pool;
+    Stats statistics;
+
+    std::size_t findOrCreate( const std::string& name );
+    [[nodiscard]] const Node& lookup( const std::string& name ) const;
+    [[nodiscard]] bool reaches( std::size_t from, std::size_t target ) const;
+    void markDirty( std::size_t id );
+    void evaluateNode( Node& node );
+};
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <simple_calculator/calculator_export.hpp>
+#include <string>
+#include <utility>
+#include <vector>
+
+// 流式列数据求值：对一个很大的数据集逐行计算同一个表达式，结果顺序写入输出文件。
+// 输入被 mmap 后按块解析进两组复用的对齐缓冲区，后台线程解析下一块的同时当前块在线程池上批量求值；
+// 已处理的输入页面会被立即交还内核，内存占用只取决于块大小和用到的列数，与数据集大小无关。
+// 表达式中的变量按名字对应输入列，不存在的列在开始前报错
+
+// 带表头的 CSV：第一行是列名，之后每行一条记录。空字段读作 NaN，无法解析的数字抛出异常并给出行号
+struct CsvInput {
+    std::string path;
+    char delimiter = ',';
+};
+
+// 每列一个原始文件，按小端 double 连续存放，各文件的行数必须相同
+struct ColumnFilesInput {
+    std::vector< std::pair< std::string, std::string > > columns;  // 列名, 文件路径
+};
+
+enum class OutputFormat {
+    BINARY,  // 小端 double，出错的行为 NaN
+    TEXT,    // 每行一个结果，出错的行为 nan
+};
+
+struct StreamOptions {
+    std::size_t chunkRows = 64 * 1024;
+    OutputFormat output   = OutputFormat::BINARY;
+};
+
+struct StreamStats {
+    std::size_t rows        = 0;
+    std::size_t chunks      = 0;
+    std::size_t errors      = 0;  // 求值出错(例如除以零)的行数
+    std::size_t bufferBytes = 0;  // 流水线分配的全部缓冲区大小
+};
+
+CALCULATOR_EXPORT StreamStats evaluateCsv( const std::string& expression, const CsvInput& input,
+                                           const std::string& outputPath, const StreamOptions& options = {} );
+CALCULATOR_EXPORT StreamStats evaluateColumnFiles( const std::string& expression, const ColumnFilesInput& input,
+                                                   const std::string& outputPath,
+                                                   const StreamOptions& options = {} );
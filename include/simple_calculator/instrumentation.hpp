@@ -0,0 +1,132 @@
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <simple_calculator/calculator_export.hpp>
+#include <string>
+
+// 热点路径插桩：词法/语法/求值各阶段耗时，token、节点与分配计数，以及按节点类型统计的求值次数和耗时。
+// 只有定义了 SIMPLE_CALCULATOR_INSTRUMENTATION(CMake 选项 simple_calculator_ENABLE_INSTRUMENTATION)时
+// 下面的 CALC_* 宏才会展开为记录代码，否则展开为空，不产生任何开销。
+// 数据由库统一收集，测试、GUI 和批处理程序读取的是同一份统计
+namespace instrumentation {
+
+    // clang-format off
+    enum class Phase : std::uint8_t { LEX, PARSE, EVALUATE, BATCH, COUNT };
+
+    enum class NodeKind : std::uint8_t {
+        NUMBER, VARIABLE, SLOT, ARRAY_VARIABLE,
+        ADD, SUBTRACT, MULTIPLY, DIVIDE, POWER, MODULO,
+        SQRT, SIN, COS, TAN, LG, LN, FACTORIAL,
+        SUM, MEAN, MIN, MAX, DOT,
+        LESS, LESS_EQUAL, GREATER, GREATER_EQUAL, EQUAL, NOT_EQUAL,
+        MINIMUM, MAXIMUM, ABS, IF,
+        COUNT
+    };
+    // clang-format on
+
+    [[nodiscard]] CALCULATOR_EXPORT const char* phaseName( Phase phase );
+    [[nodiscard]] CALCULATOR_EXPORT const char* nodeKindName( NodeKind kind );
+
+    struct PhaseStats {
+        std::uint64_t calls       = 0;
+        std::uint64_t nanoseconds = 0;
+    };
+
+    struct NodeStats {
+        std::uint64_t evaluations      = 0;
+        std::uint64_t totalNanoseconds = 0;  // 包含子节点
+        std::uint64_t selfNanoseconds  = 0;  // 不含子节点，用于定位昂贵的子表达式
+    };
+
+    struct Snapshot {
+        std::array< PhaseStats, static_cast< std::size_t >( Phase::COUNT ) > phases{};
+        std::array< NodeStats, static_cast< std::size_t >( NodeKind::COUNT ) > nodes{};
+        std::uint64_t tokens      = 0;
+        std::uint64_t nodesBuilt  = 0;
+        std::uint64_t allocations = 0;
+
+        [[nodiscard]] const PhaseStats& phase( Phase p ) const {
+            return phases[ static_cast< std::size_t >( p ) ];
+        }
+        [[nodiscard]] const NodeStats& node( NodeKind kind ) const {
+            return nodes[ static_cast< std::size_t >( kind ) ];
+        }
+    };
+
+    // 编译时是否启用了插桩
+    [[nodiscard]] constexpr bool enabled() {
+#ifdef SIMPLE_CALCULATOR_INSTRUMENTATION
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    CALCULATOR_EXPORT void reset();
+    [[nodiscard]] CALCULATOR_EXPORT Snapshot snapshot();
+    // Chrome trace-event JSON(chrome://tracing / Perfetto 可直接打开)
+    CALCULATOR_EXPORT void writeChromeTrace( std::ostream& out );
+    [[nodiscard]] CALCULATOR_EXPORT std::string summary();
+    // 通过 spdlog 以 info 级别输出 summary()
+    CALCULATOR_EXPORT void logSummary();
+
+    // 以下为宏使用的记录接口
+    CALCULATOR_EXPORT void countToken();
+    CALCULATOR_EXPORT void countNode();
+    CALCULATOR_EXPORT void countAllocation();
+
+    class CALCULATOR_EXPORT PhaseScope {
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+        bool traced;
+
+    public:
+        // traced 为 false 时只累计耗时，不生成 trace 事件(用于调用极其频繁的 nextToken)
+        explicit PhaseScope( Phase p, bool trace = true );
+        ~PhaseScope();
+        PhaseScope( const PhaseScope& )            = delete;
+        PhaseScope& operator=( const PhaseScope& ) = delete;
+    };
+
+    // 节点求值计时；最外层的节点同时记为一次 EVALUATE 阶段
+    class CALCULATOR_EXPORT NodeScope {
+        NodeKind kind;
+        std::chrono::steady_clock::time_point start;
+        std::uint64_t childNanoseconds = 0;
+        NodeScope* parent;
+
+    public:
+        explicit NodeScope( NodeKind k );
+        ~NodeScope();
+        NodeScope( const NodeScope& )            = delete;
+        NodeScope& operator=( const NodeScope& ) = delete;
+    };
+
+}  // namespace instrumentation
+
+#define CALC_CONCAT_IMPL( a, b ) a##b
+#define CALC_CONCAT( a, b )      CALC_CONCAT_IMPL( a, b )
+
+#ifdef SIMPLE_CALCULATOR_INSTRUMENTATION
+#define CALC_PROFILE_PHASE( phase ) \
+    const instrumentation::PhaseScope CALC_CONCAT( calcPhaseScope, __LINE__ )( instrumentation::Phase::phase )
+#define CALC_PROFILE_PHASE_UNTRACED( phase )                                                                 \
+    const instrumentation::PhaseScope CALC_CONCAT( calcPhaseScope, __LINE__ )( instrumentation::Phase::phase, \
+                                                                                false )
+#define CALC_PROFILE_NODE( kind ) \
+    const instrumentation::NodeScope CALC_CONCAT( calcNodeScope, __LINE__ )( instrumentation::NodeKind::kind )
+#define CALC_COUNT_TOKEN()      instrumentation::countToken()
+#define CALC_COUNT_NODE()       instrumentation::countNode()
+#define CALC_COUNT_ALLOCATION() instrumentation::countAllocation()
+#else
+#define CALC_PROFILE_PHASE( phase )          static_cast< void >( 0 )
+#define CALC_PROFILE_PHASE_UNTRACED( phase ) static_cast< void >( 0 )
+#define CALC_PROFILE_NODE( kind )            static_cast< void >( 0 )
+#define CALC_COUNT_TOKEN()                   static_cast< void >( 0 )
+#define CALC_COUNT_NODE()                    static_cast< void >( 0 )
+#define CALC_COUNT_ALLOCATION()              static_cast< void >( 0 )
+#endif
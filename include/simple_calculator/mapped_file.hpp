@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <simple_calculator/calculator_export.hpp>
+#include <span>
+#include <string>
+
+// 只读内存映射文件。空文件得到空的映射
+class CALCULATOR_EXPORT MappedFile {
+    const std::byte* bytes = nullptr;
+    std::size_t length     = 0;
+
+    void release();
+
+public:
+    MappedFile() = default;
+    // 打开失败时抛出 std::runtime_error
+    explicit MappedFile( const std::string& path );
+    ~MappedFile();
+    MappedFile( MappedFile&& other ) noexcept;
+    MappedFile& operator=( MappedFile&& other ) noexcept;
+    MappedFile( const MappedFile& )            = delete;
+    MappedFile& operator=( const MappedFile& ) = delete;
+
+    [[nodiscard]] const std::byte* data() const {
+        return bytes;
+    }
+    [[nodiscard]] std::size_t size() const {
+        return length;
+    }
+    [[nodiscard]] std::span< const std::byte > span() const {
+        return { bytes, length };
+    }
+
+    // 提示内核即将顺序读取 [offset, offset + size)，提前发起读盘
+    void prefetch( std::size_t offset, std::size_t size ) const;
+    // 不再需要 [offset, offset + size)，让内核回收这些页面，顺序扫描大文件时驻留内存不随文件大小增长。
+    // 首尾都向下对齐到整页(到达文件末尾时包含最后一页)，所以调用方同样不能再需要 offset 所在页的开头部分。
+    // 之后再读这段内存会重新从文件读入
+    void discard( std::size_t offset, std::size_t size ) const;
+};
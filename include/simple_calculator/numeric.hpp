@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <simple_calculator/calculator.hpp>
+#include <simple_calculator/calculator_export.hpp>
+#include <span>
+#include <string>
+#include <utility>
+
+// 单变量函数 f(variable)：表达式只解析和编译一次，之后按批求值并统计求值次数
+class CALCULATOR_EXPORT UnivariateFunction {
+    double scalar = 0;
+    std::unique_ptr< ASTNode > ast;
+    BatchProgram program;
+    std::size_t count = 0;
+
+public:
+    // fallback 用于解析 variable 以外的标识符，例如 ArrayBindings::resolver()
+    UnivariateFunction( const std::string& expression, const std::string& variable,
+                        const Parser::Resolver& fallback = {} );
+
+    // 对 xs 中的每个点求值；status 为空时任何一点出错都会抛出 std::runtime_error
+    void evaluate( std::span< const double > xs, std::span< double > out, EvalStatus* status = nullptr );
+    double operator()( double x );
+
+    [[nodiscard]] std::size_t evaluations() const {
+        return count;
+    }
+    void resetEvaluations() {
+        count = 0;
+    }
+};
+
+struct SolveResult {
+    double root             = 0;
+    double residual         = 0;  // f(root)
+    std::size_t evaluations = 0;
+    std::size_t iterations  = 0;
+    bool converged          = false;
+};
+
+struct IntegrateResult {
+    double value            = 0;
+    double errorEstimate    = 0;
+    std::size_t evaluations = 0;
+    std::size_t intervals   = 0;  // 最终的子区间数
+    bool converged          = false;
+};
+
+// Brent 法求 [bracket.first, bracket.second] 内 f(x)=0 的根，要求端点函数值异号
+CALCULATOR_EXPORT SolveResult solve( UnivariateFunction& f, std::pair< double, double > bracket,
+                                     double tolerance = 1e-12, std::size_t maxIterations = 200 );
+CALCULATOR_EXPORT SolveResult solve( const std::string& expression, const std::string& variable,
+                                     std::pair< double, double > bracket, double tolerance = 1e-12 );
+
+// 自适应 Gauss-Kronrod(G7-K15) 求积：每一轮把所有需要细分的子区间的节点合成一批求值；
+// 子区间数超过 maxIntervals 时停止细分并返回 converged = false
+CALCULATOR_EXPORT IntegrateResult integrate( UnivariateFunction& f, double a, double b, double tolerance = 1e-10,
+                                             std::size_t maxIntervals = 1000 );
+CALCULATOR_EXPORT IntegrateResult integrate( const std::string& expression, const std::string& variable, double a,
+                                             double b, double tolerance = 1e-10 );
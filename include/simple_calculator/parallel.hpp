@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <simple_calculator/calculator_export.hpp>
+#include <simple_calculator/thread_pool.hpp>
+#include <vector>
+
+class ASTNode;
+class BinaryOpNode;
+class UnaryFunctionNode;
+
+// 单棵大表达式树的并行求值。
+// 解析器的循环把 a + b + c + ... 和 a * b / c ... 构造成很深的左深链条，既不能直接拆分，递归求值还会耗尽调用栈。
+// 这里先用显式栈把树展开成后序排列的计划，同一优先级的左深链条压平为一个多元节点；
+// 代价超过 grain 的子树拆成线程池上的任务，其余子树在一个任务内按后序顺序循环求值，整个过程都不递归整棵树
+
+// 浮点重结合策略
+enum class Reassociation {
+    // 与 ASTNode::evaluate() 逐位相同：链条的各项并行求值，但严格按从左到右的顺序合并
+    EXACT,
+    // 只由 + 和 - 或只由 * 组成的链条按固定的平衡二叉树合并，a - b 按 a + (-b) 处理(取负是精确的)。
+    // 合并顺序只取决于表达式本身，与线程数和调度无关，结果可以复现；
+    // 与 evaluate() 的差别在舍入误差量级，成对合并的误差随项数按 O(log n) 增长，通常比从左到右的 O(n) 更小。
+    // 但中间结果的上溢和下溢可能不同，例如 1e308 + 1e308 - 1e308 顺序求值为 inf，重排后可能是有限值。
+    // 含 / 或 % 的链条不满足结合律，始终按顺序合并
+    BALANCED,
+};
+
+struct ParallelOptions {
+    Reassociation reassociation = Reassociation::BALANCED;
+    // 代价(cost_weight 的单位，约等于基本运算次数)不超过 grain 的子树在一个任务内顺序求值
+    double grain = 2e4;
+    // 为空时使用 sharedThreadPool()
+    ThreadPool* pool = nullptr;
+};
+
+// 二元运算在左深链条中的角色
+enum class ChainLink {
+    NONE,                     // 不形成链条，例如右结合的 ^
+    ADD, SUBTRACT, MULTIPLY,  // 可以按结合律重排
+    ORDERED,                  // 与 * 同一优先级但不满足结合律的 / 和 %，只能按顺序合并
+};
+
+// ASTNode::plan 的接收方：每个节点只报告自己的形状，不递归访问子节点
+class ParallelPlanner {
+public:
+    enum class Kind { LEAF, UNARY, BINARY };
+    struct Shape {
+        Kind kind;
+        const ASTNode* node;
+        const ASTNode* children[ 2 ];
+        ChainLink link;
+    };
+
+    // 不可拆分的子树，整体调用 evaluate()
+    void leaf( const ASTNode& node ) {
+        current = Shape{ Kind::LEAF, &node, { nullptr, nullptr }, ChainLink::NONE };
+    }
+    void unary( const UnaryFunctionNode& node, const ASTNode& operand );
+    void binary( const BinaryOpNode& node, const ASTNode& left, const ASTNode& right, ChainLink link );
+
+    [[nodiscard]] const Shape& shape() const {
+        return current;
+    }
+
+private:
+    Shape current{};
+};
+
+// 为一棵表达式树建立一次计划，之后可以反复求值(例如变量的值改变之后)；计划不能比树活得更久。
+// 出错时抛出 std::runtime_error；有多个错误时抛出的不一定是顺序求值遇到的第一个
+class CALCULATOR_EXPORT ParallelEvaluator {
+public:
+    explicit ParallelEvaluator( const ASTNode& root, const ParallelOptions& options = {} );
+
+    double evaluate();
+
+    [[nodiscard]] std::size_t nodes() const {
+        return plan.size();
+    }
+    // 压平后的链条数和其中最长的项数
+    [[nodiscard]] std::size_t chains() const {
+        return chainCount;
+    }
+    [[nodiscard]] std::size_t longestChain() const {
+        return longest;
+    }
+    [[nodiscard]] double cost() const {
+        return plan.empty() ? 0 : plan.back().cost;
+    }
+
+private:
+    enum class Kind : std::uint8_t { LEAF, UNARY, BINARY, CHAIN };
+    enum class Merge : std::uint8_t { ORDERED, SUM, PRODUCT };
+
+    struct Node {
+        Kind kind;
+        Merge merge;  // CHAIN 的合并方式
+        const ASTNode* node;
+        std::uint32_t first;      // 子树在后序中的第一个位置
+        std::uint32_t termBegin;  // 子节点在 terms 中的位置
+        std::uint32_t termCount;
+        double cost;
+    };
+    struct Term {
+        std::uint32_t child;
+        const BinaryOpNode* op;  // 链条中把这一项合并进来的运算，第一项为空
+        bool negate;             // SUM 中由减号引入的项
+        double prefixCost;       // 链条中到这一项为止(含)的代价之和
+    };
+
+    std::vector< Node > plan;
+    std::vector< Term > terms;
+    std::vector< double > values;
+    ParallelOptions options;
+    std::size_t chainCount = 0;
+    std::size_t longest    = 0;
+
+    void build( const ASTNode& root );
+    void evaluateRange( std::uint32_t first, std::uint32_t last );
+    void evaluateNode( std::uint32_t index );
+    double reduce( const Node& node, std::uint32_t lo, std::uint32_t hi );
+    [[nodiscard]] double combine( const Node& node ) const;
+    [[nodiscard]] double pairwise( const Node& node, std::uint32_t lo, std::uint32_t hi ) const;
+    [[nodiscard]] double termCost( const Node& node, std::uint32_t lo, std::uint32_t hi ) const;
+    [[nodiscard]] double compute( const Node& node ) const;
+};
+
+// 一次性的便捷接口
+[[nodiscard]] CALCULATOR_EXPORT double evaluateParallel( const ASTNode& root, const ParallelOptions& options = {} );
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <simple_calculator/calculator_export.hpp>
+#include <simple_calculator/numeric.hpp>
+#include <string>
+#include <vector>
+
+// 绘图视口：数据坐标范围和像素尺寸
+struct PlotViewport {
+    double xmin = -10, xmax = 10;
+    double ymin = -10, ymax = 10;
+    std::size_t width = 400, height = 300;
+
+    [[nodiscard]] double pixelWidth() const {
+        return ( xmax - xmin ) / static_cast< double >( width );
+    }
+    [[nodiscard]] double pixelHeight() const {
+        return ( ymax - ymin ) / static_cast< double >( height );
+    }
+};
+
+// 一个像素列内样本的 min/max 抽取结果
+struct PlotColumn {
+    std::size_t samples = 0;   // 列内有效样本数，为 0 时该列只由相邻列的连线经过
+    double min = 0, max = 0;   // 列内 y 的范围，画一条竖线
+    double first = 0, last = 0;
+    bool breakBefore = false;  // 与左侧最近的有样本列之间有间断(无定义或极点)，不连线
+};
+
+// 自适应采样器：先按与缩放级别对齐的粗网格采样，再只在曲率大、跨越定义域边界或跳变的地方细分；
+// 采样点在多次调用之间缓存，平移和缩放时只补充缺失的部分
+class CALCULATOR_EXPORT PlotSampler {
+public:
+    struct Stats {
+        std::size_t evaluations = 0;  // 最近一次 sample() 新求值的点数
+        std::size_t cached      = 0;  // 当前缓存的点数
+        std::size_t rounds      = 0;  // 最近一次 sample() 的细分轮数
+    };
+
+    PlotSampler( const std::string& expression, const std::string& variable = "x" );
+
+    // 返回 viewport.width 个像素列
+    std::vector< PlotColumn > sample( const PlotViewport& viewport );
+
+    [[nodiscard]] const Stats& stats() const {
+        return statistics;
+    }
+
+private:
+    struct Point {
+        double x, y;
+        bool valid;
+        bool breakBefore = false;
+    };
+
+    UnivariateFunction function;
+    std::vector< Point > points;  // 按 x 升序
+    Stats statistics;
+
+    void add( std::vector< double >& xs );
+    void evict( const PlotViewport& viewport );
+};
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <simple_calculator/batch.hpp>
+#include <simple_calculator/calculator_export.hpp>
+#include <span>
+
+class ASTNode;
+
+// 单精度求值与自动回退。
+// 只需要 6 位左右有效数字时按 float 求值，批量内层循环的向量宽度加倍、内存流量减半；
+// 但相近数相减、大参数的三角函数等病态运算会把 float 的舍入误差放大到不可接受，
+// 所以每个表达式先在一组样本行上与 double 的结果比较，估计的相对误差超过阈值时改用 double 计算
+
+enum class Precision { FLOAT32, FLOAT64 };
+
+struct PrecisionOptions {
+    // 允许的最大相对误差。float 的单位舍入约为 6e-8，默认值对应约 6 位有效数字
+    double tolerance = 1e-6;
+    // 误差估计使用的样本行数，在 [0, rows) 中均匀选取
+    std::size_t samples = 256;
+};
+
+struct PrecisionEstimate {
+    Precision precision     = Precision::FLOAT32;
+    double maxRelativeError = 0;  // 样本上 float 相对于 double 的最大相对误差
+    std::size_t samples     = 0;  // 实际比较的行数，两条路径报告同一错误的行不计入
+};
+
+// 在 [0, rows) 的样本行上比较 float 与 double 两条路径，选出满足 options.tolerance 的精度。
+// 某一行两者的错误状态不同(例如只有 float 下溢为 0 后除零)或只有 float 溢出时，误差记为无穷大；
+// 结果为 0 而 float 不为 0 时按相对 float 最小正规数的误差计，实际上总会回退
+[[nodiscard]] CALCULATOR_EXPORT PrecisionEstimate estimatePrecision( const BatchEvaluator& evaluator,
+                                                                     std::size_t rows,
+                                                                     const PrecisionOptions& options = {} );
+
+// 构造时估计误差并固定精度，之后 run() 可以在多个线程上并发调用。
+// 结果总是以 float 输出：回退到 double 时舍入一次，误差不超过 float 的单位舍入
+class CALCULATOR_EXPORT MixedPrecisionEvaluator {
+    BatchEvaluator evaluator;
+    PrecisionEstimate report;
+
+public:
+    // rows 为输入列的行数，只用于选取样本
+    MixedPrecisionEvaluator( const BatchProgram& program, std::span< const Column > columns, std::size_t rows,
+                             const PrecisionOptions& options = {} );
+
+    [[nodiscard]] Precision precision() const {
+        return report.precision;
+    }
+    [[nodiscard]] const PrecisionEstimate& estimate() const {
+        return report;
+    }
+
+    // 错误处理与 BatchEvaluator::run 相同
+    void run( std::size_t offset, std::size_t count, float* out, EvalStatus* status = nullptr ) const;
+};
+
+// 标量单精度求值：整棵树按 float 计算，变量等标量子表达式的值按 double 取得后舍入。
+// 单个标量没有可以摊销的样本，估计误差本身就要做一次 double 求值，所以标量路径不做回退。
+// 出错时抛出 std::runtime_error
+[[nodiscard]] CALCULATOR_EXPORT float evaluateFloat( const ASTNode& root );
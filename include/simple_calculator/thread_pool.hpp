@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 固定大小的线程池，调用线程也参与 parallelFor 的计算
+class ThreadPool {
+    std::vector< std::thread > workers;
+    std::deque< std::function< void() > > tasks;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping = false;
+
+    void workerLoop() {
+        for ( ;; ) {
+            std::function< void() > task;
+            {
+                std::unique_lock lock( mutex );
+                available.wait( lock, [ this ] { return stopping || !tasks.empty(); } );
+                if ( stopping && tasks.empty() )
+                    return;
+                task = std::move( tasks.front() );
+                tasks.pop_front();
+            }
+            task();
+        }
+    }
+
+public:
+    // threads 为 0 时不创建工作线程，所有任务都在调用线程上执行
+    explicit ThreadPool( std::size_t threads = std::thread::hardware_concurrency() ) {
+        workers.reserve( threads );
+        for ( std::size_t i = 0; i < threads; ++i )
+            workers.emplace_back( [ this ] { workerLoop(); } );
+    }
+
+    ~ThreadPool() {
+        {
+            std::scoped_lock lock( mutex );
+            stopping = true;
+        }
+        available.notify_all();
+        for ( auto& worker : workers )
+            worker.join();
+    }
+
+    ThreadPool( const ThreadPool& )            = delete;
+    ThreadPool& operator=( const ThreadPool& ) = delete;
+
+    [[nodiscard]] std::size_t size() const {
+        return workers.size();
+    }
+
+    void submit( std::function< void() > task ) {
+        {
+            std::scoped_lock lock( mutex );
+            tasks.push_back( std::move( task ) );
+        }
+        available.notify_one();
+    }
+
+    // 将 [0, count) 按 grain 切块并行执行 fn(begin, end)，阻塞直到全部完成；
+    // 第一个抛出的异常会在调用线程上重新抛出
+    void parallelFor( std::size_t count, const std::function< void( std::size_t, std::size_t ) >& fn,
+                      std::size_t grain = 1 ) {
+        grain              = std::max< std::size_t >( grain, 1 );
+        std::size_t chunks = ( count + grain - 1 ) / grain;
+        if ( chunks == 0 )
+            return;
+        if ( workers.empty() || chunks == 1 ) {
+            fn( 0, count );
+            return;
+        }
+
+        // 辅助任务可能在所有块完成后才被调度到，此时 closed 已置位，直接返回而不再访问 fn；
+        // 调用线程只等待已经开始执行的辅助任务，因此嵌套调用也不会因为工作线程全部阻塞而死锁
+        struct State {
+            std::atomic< std::size_t > next{ 0 };
+            std::size_t active = 0;
+            bool closed        = false;
+            std::exception_ptr error;
+            std::mutex mutex;
+            std::condition_variable done;
+        };
+        auto state = std::make_shared< State >();
+
+        auto run = [ state, &fn, count, grain, chunks ] {
+            for ( std::size_t chunk = state->next++; chunk < chunks; chunk = state->next++ ) {
+                try {
+                    std::size_t begin = chunk * grain;
+                    fn( begin, std::min( begin + grain, count ) );
+                }
+                catch ( ... ) {
+                    std::scoped_lock lock( state->mutex );
+                    if ( !state->error )
+                        state->error = std::current_exception();
+                }
+            }
+        };
+
+        std::size_t helpers = std::min( workers.size(), chunks - 1 );
+        for ( std::size_t i = 0; i < helpers; ++i ) {
+            submit( [ state, run ] {
+                {
+                    std::scoped_lock lock( state->mutex );
+                    if ( state->closed )
+                        return;
+                    ++state->active;
+                }
+                run();
+                std::scoped_lock lock( state->mutex );
+                if ( --state->active == 0 )
+                    state->done.notify_one();
+            } );
+        }
+        run();
+
+        std::unique_lock lock( state->mutex );
+        state->closed = true;
+        state->done.wait( lock, [ &state ] { return state->active == 0; } );
+        if ( state->error )
+            std::rethrow_exception( state->error );
+    }
+};
+
+// 进程内共享的线程池，供批量归约等库内部的并行计算使用；调用线程也参与计算，所以少开一个工作线程
+inline ThreadPool& sharedThreadPool() {
+    static ThreadPool pool( std::max( std::thread::hardware_concurrency(), 1U ) - 1 );
+    return pool;
+}
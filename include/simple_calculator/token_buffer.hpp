@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <simple_calculator/calculator_export.hpp>
+#include <string>
+#include <string_view>
+#include <vector>
+
+enum class TokenType;
+
+// 批量词法分析的结果，按结构数组(SoA)存放：每个 token 占 type + offset + length 共 9 字节，
+// 数字的值单独按出现顺序存放在 values 中。标识符的名字由 offset/length 指回原始输入
+struct TokenBuffer {
+    std::vector< std::uint8_t > types;  // TokenType
+    std::vector< std::uint32_t > offsets;
+    std::vector< std::uint32_t > lengths;
+    std::vector< double > values;  // 依次对应每个 NUMBER token
+
+    // 遇到非法字符或非法数字时在此处停止，读到这里时再报错，与逐字符 Lexer 报错的时机一致
+    bool failed = false;
+    std::string error;
+
+    [[nodiscard]] std::size_t size() const {
+        return types.size();
+    }
+    [[nodiscard]] TokenType type( std::size_t i ) const {
+        return static_cast< TokenType >( types[ i ] );
+    }
+};
+
+// 一次扫描整个输入：用 SIMD 比较把每 64 字节分类为空白、数字、标识符字符和单字符运算符的位掩码，
+// 再按位扫描得到 token 边界。x86-64 上运行时选择 AVX2 或 SSE2，其它平台使用查表实现。
+// 结果不含 END，输入不能超过 4 GiB
+[[nodiscard]] CALCULATOR_EXPORT TokenBuffer tokenize( std::string_view input );
+
+// 当前使用的扫描实现："avx2"、"sse2" 或 "scalar"
+[[nodiscard]] CALCULATOR_EXPORT const char* tokenizerBackend();
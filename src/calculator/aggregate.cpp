@@ -0,0 +1,147 @@
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <simple_calculator/calculator.hpp>
+#include <simple_calculator/thread_pool.hpp>
+#include <vector>
+
+namespace {
+    // 归约分块大小固定，与线程数无关，保证结果可复现
+    constexpr std::size_t REDUCE_CHUNK = 16384;
+    // 每次批量求值的样本数，结果缓冲区保持在 L1 中
+    constexpr std::size_t REDUCE_BLOCK = 1024;
+    // 超过该元素数才使用线程池
+    constexpr std::size_t PARALLEL_THRESHOLD = 1 << 17;
+    // Kahan 求和的独立累加路数，各路之间没有依赖，编译器可以向量化
+    constexpr std::size_t LANES = 8;
+
+    class CompensatedSum {
+        std::array< double, LANES > sum{};
+        std::array< double, LANES > compensation{};
+
+    public:
+        void add( const double* values, std::size_t n ) {
+            std::size_t i = 0;
+            for ( ; i + LANES <= n; i += LANES ) {
+                for ( std::size_t lane = 0; lane < LANES; ++lane ) {
+                    double y             = values[ i + lane ] - compensation[ lane ];
+                    double t             = sum[ lane ] + y;
+                    compensation[ lane ] = ( t - sum[ lane ] ) - y;
+                    sum[ lane ]          = t;
+                }
+            }
+            for ( std::size_t lane = 0; i < n; ++i, ++lane ) {
+                double y             = values[ i ] - compensation[ lane ];
+                double t             = sum[ lane ] + y;
+                compensation[ lane ] = ( t - sum[ lane ] ) - y;
+                sum[ lane ]          = t;
+            }
+        }
+
+        [[nodiscard]] double total() const {
+            // 各路按 Neumaier 方式合并
+            double result = 0;
+            double carry  = 0;
+            for ( std::size_t lane = 0; lane < LANES; ++lane ) {
+                double value = sum[ lane ] - compensation[ lane ];
+                double t     = result + value;
+                carry += std::abs( result ) >= std::abs( value ) ? ( result - t ) + value : ( value - t ) + result;
+                result = t;
+            }
+            return result + carry;
+        }
+    };
+
+    double pairwiseSum( const double* values, std::size_t n ) {
+        if ( n <= 2 )
+            return n == 0 ? 0 : ( n == 1 ? values[ 0 ] : values[ 0 ] + values[ 1 ] );
+        std::size_t half = n / 2;
+        return pairwiseSum( values, half ) + pairwiseSum( values + half, n - half );
+    }
+}  // namespace
+
+AggregateNode::AggregateNode( std::unique_ptr< ASTNode > b ) : body( std::move( b ) ), program( compileBatch( *body ) ) {
+    if ( program.columns.empty() )
+        throw std::runtime_error( "Aggregate function needs an array argument" );
+}
+
+void AggregateNode::compile( BatchCompiler& compiler ) const {
+    auto inputs        = compiler.inputColumns();
+    std::size_t outer  = inputs.size();
+    BatchProgram probe = compileBatch( *body, std::move( inputs ) );
+    for ( const Instruction& ins : probe.code ) {
+        if ( ins.op == OpCode::PUSH_COLUMN && ins.operand < outer )
+            throw std::runtime_error( "Aggregate body depends on batch input: " + probe.columns[ ins.operand ] );
+    }
+    compiler.emitCall( *this );
+}
+
+void AggregateNode::estimate( CostEstimator& estimator ) const {
+    CostEstimator inner;
+    body->estimate( inner );
+    estimator.enter();
+    estimator.aggregate( inner );
+    estimator.leave();
+}
+
+double AggregateNode::reduce( Reduction reduction, std::size_t& count ) const {
+    std::vector< Column > columns;
+    columns.reserve( program.sources.size() );
+    count = program.sources.front()->size();
+    for ( std::size_t i = 0; i < program.sources.size(); ++i ) {
+        const auto& source = *program.sources[ i ];
+        if ( source.size() != count )
+            throw std::runtime_error( "Array length mismatch in aggregate: " + program.columns[ i ] );
+        columns.push_back( Column{ source.data(), 1 } );
+    }
+
+    BatchEvaluator evaluator( program, columns );
+    std::size_t chunks = ( count + REDUCE_CHUNK - 1 ) / REDUCE_CHUNK;
+    std::vector< double > partials( chunks );
+
+    // 工作线程沿用调用线程的时限，evaluator.run() 每个块都会检查
+    auto deadline = currentDeadline();
+    auto work     = [ & ]( std::size_t first, std::size_t last ) {
+        DeadlineScope scope( deadline );
+        std::array< double, REDUCE_BLOCK > buffer;
+        for ( std::size_t chunk = first; chunk < last; ++chunk ) {
+            std::size_t begin = chunk * REDUCE_CHUNK;
+            std::size_t end   = std::min( begin + REDUCE_CHUNK, count );
+            CompensatedSum sum;
+            double extreme = reduction == Reduction::MIN ? std::numeric_limits< double >::infinity()
+                                                         : -std::numeric_limits< double >::infinity();
+            for ( std::size_t offset = begin; offset < end; offset += REDUCE_BLOCK ) {
+                std::size_t n = std::min( REDUCE_BLOCK, end - offset );
+                evaluator.run( offset, n, buffer.data() );
+                switch ( reduction ) {
+                case Reduction::SUM:
+                    sum.add( buffer.data(), n );
+                    break;
+                case Reduction::MIN:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        extreme = buffer[ i ] < extreme ? buffer[ i ] : extreme;
+                    break;
+                case Reduction::MAX:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        extreme = buffer[ i ] > extreme ? buffer[ i ] : extreme;
+                    break;
+                }
+            }
+            partials[ chunk ] = reduction == Reduction::SUM ? sum.total() : extreme;
+        }
+    };
+    if ( count >= PARALLEL_THRESHOLD )
+        sharedThreadPool().parallelFor( chunks, work );
+    else
+        work( 0, chunks );
+
+    switch ( reduction ) {
+    case Reduction::SUM:
+        return pairwiseSum( partials.data(), partials.size() );
+    case Reduction::MIN:
+        return partials.empty() ? 0 : *std::min_element( partials.begin(), partials.end() );
+    case Reduction::MAX:
+        return partials.empty() ? 0 : *std::max_element( partials.begin(), partials.end() );
+    }
+    return 0;
+}
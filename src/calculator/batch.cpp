@@ -0,0 +1,533 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <simple_calculator/batch.hpp>
+#include <simple_calculator/calculator.hpp>
+#include <stdexcept>
+#include <type_traits>
+
+const char* evalStatusMessage( EvalStatus status ) {
+    switch ( status ) {
+    case EvalStatus::OK:
+        return "OK";
+    case EvalStatus::DIVISION_BY_ZERO:
+        return "Division by zero";
+    case EvalStatus::MODULO_BY_ZERO:
+        return "Modulo by zero";
+    case EvalStatus::SQRT_NEGATIVE:
+        return "Square root of negative number";
+    case EvalStatus::TAN_UNDEFINED:
+        return "Tangent undefined (division by zero)";
+    case EvalStatus::LG_NON_POSITIVE:
+        return "Logarithm of non-positive number";
+    case EvalStatus::LN_NON_POSITIVE:
+        return "Natural logarithm of non-positive number";
+    case EvalStatus::FACTORIAL_NEGATIVE:
+        return "Factorial of negative number";
+    case EvalStatus::FACTORIAL_NON_INTEGER:
+        return "Factorial only defined for non-negative integers";
+    }
+    return "Unknown error";
+}
+
+BatchCompiler::BatchCompiler( std::vector< std::string > columns ) {
+    program.columns = std::move( columns );
+    program.sources.resize( program.columns.size(), nullptr );
+}
+
+void BatchCompiler::push() {
+    ++depth;
+    program.maxDepth = std::max( program.maxDepth, depth );
+}
+
+std::optional< std::uint32_t > BatchCompiler::findColumn( const std::string& name ) const {
+    auto it = std::find( program.columns.begin(), program.columns.end(), name );
+    if ( it == program.columns.end() )
+        return std::nullopt;
+    return static_cast< std::uint32_t >( it - program.columns.begin() );
+}
+
+std::vector< std::string > BatchCompiler::inputColumns() const {
+    std::vector< std::string > names;
+    for ( std::size_t i = 0; i < program.columns.size(); ++i ) {
+        if ( !program.sources[ i ] )
+            names.push_back( program.columns[ i ] );
+    }
+    return names;
+}
+
+std::uint32_t BatchCompiler::addColumn( const std::string& name, const std::span< const double >* source ) {
+    if ( auto column = findColumn( name ) )
+        return *column;
+    program.columns.push_back( name );
+    program.sources.push_back( source );
+    return static_cast< std::uint32_t >( program.columns.size() - 1 );
+}
+
+void BatchCompiler::emitConstant( double value ) {
+    program.code.push_back( Instruction{ .op = OpCode::PUSH_CONST, .immediate = value } );
+    push();
+}
+
+void BatchCompiler::emitColumn( std::uint32_t column ) {
+    program.code.push_back( Instruction{ .op = OpCode::PUSH_COLUMN, .operand = column } );
+    push();
+}
+
+void BatchCompiler::emitCall( const ASTNode& node ) {
+    program.calls.push_back( &node );
+    program.code.push_back(
+        Instruction{ .op = OpCode::PUSH_CALL, .operand = static_cast< std::uint32_t >( program.calls.size() - 1 ) } );
+    push();
+}
+
+void BatchCompiler::emit( OpCode op ) {
+    switch ( op ) {
+    case OpCode::PUSH_CONST:
+    case OpCode::PUSH_COLUMN:
+    case OpCode::PUSH_CALL:
+        throw std::logic_error( "Push instructions need an operand" );
+    case OpCode::ADD:
+    case OpCode::SUB:
+    case OpCode::MUL:
+    case OpCode::DIV:
+    case OpCode::POW:
+    case OpCode::MOD:
+    case OpCode::LT:
+    case OpCode::LE:
+    case OpCode::GT:
+    case OpCode::GE:
+    case OpCode::EQ:
+    case OpCode::NE:
+    case OpCode::MIN:
+    case OpCode::MAX:
+        --depth;
+        break;
+    case OpCode::SELECT:
+        depth -= 2;
+        break;
+    default:
+        break;
+    }
+    program.code.push_back( Instruction{ .op = op } );
+}
+
+BatchProgram BatchCompiler::finish() {
+    return std::move( program );
+}
+
+namespace {
+    // 指令弹出的操作数个数
+    std::uint32_t operandCount( OpCode op ) {
+        switch ( op ) {
+        case OpCode::PUSH_CONST:
+        case OpCode::PUSH_COLUMN:
+        case OpCode::PUSH_CALL:
+            return 0;
+        case OpCode::ADD:
+        case OpCode::SUB:
+        case OpCode::MUL:
+        case OpCode::DIV:
+        case OpCode::POW:
+        case OpCode::MOD:
+        case OpCode::LT:
+        case OpCode::LE:
+        case OpCode::GT:
+        case OpCode::GE:
+        case OpCode::EQ:
+        case OpCode::NE:
+        case OpCode::MIN:
+        case OpCode::MAX:
+            return 2;
+        case OpCode::SELECT:
+            return 3;
+        default:
+            return 1;
+        }
+    }
+}  // namespace
+
+void foldConstants( BatchProgram& program ) {
+    std::vector< Instruction > folded;
+    folded.reserve( program.code.size() );
+    for ( const Instruction& ins : program.code ) {
+        folded.push_back( ins );
+        std::uint32_t arity = operandCount( ins.op );
+        if ( arity == 0 || folded.size() <= arity )
+            continue;
+        std::size_t first = folded.size() - 1 - arity;
+        if ( !std::all_of( folded.begin() + static_cast< std::ptrdiff_t >( first ), folded.end() - 1,
+                           []( const Instruction& operand ) { return operand.op == OpCode::PUSH_CONST; } ) )
+            continue;
+        // 用求值器本身计算，保证与运行时的结果逐位相同
+        double value      = 0;
+        EvalStatus status = EvalStatus::OK;
+        runProgram( ProgramView{ std::span< const Instruction >( folded ).subspan( first ), arity }, {}, {}, 0, 1,
+                    &value, &status );
+        if ( status != EvalStatus::OK )
+            continue;
+        folded.resize( first );
+        folded.push_back( Instruction{ .op = OpCode::PUSH_CONST, .immediate = value } );
+    }
+
+    std::uint32_t depth = 0;
+    program.maxDepth    = 0;
+    for ( const Instruction& ins : folded ) {
+        std::uint32_t arity = operandCount( ins.op );
+        depth               = arity == 0 ? depth + 1 : depth - arity + 1;
+        program.maxDepth    = std::max( program.maxDepth, depth );
+    }
+    program.code = std::move( folded );
+}
+
+BatchProgram compileBatch( const ASTNode& root, std::vector< std::string > columns ) {
+    BatchCompiler compiler( std::move( columns ) );
+    root.compile( compiler );
+    return compiler.finish();
+}
+
+BatchEvaluator::BatchEvaluator( const BatchProgram& prog, std::span< const Column > columns ) : program( prog ) {
+    if ( columns.size() < program.columns.size() )
+        throw std::invalid_argument( "Batch program needs " + std::to_string( program.columns.size() ) + " columns" );
+    inputs.assign( columns.begin(), columns.end() );
+    callValues.reserve( program.calls.size() );
+    callStatus.reserve( program.calls.size() );
+    for ( const ASTNode* node : program.calls ) {
+        try {
+            callValues.push_back( node->evaluate() );
+            callStatus.push_back( EvalStatus::OK );
+        }
+        catch ( const EvaluationError& e ) {
+            // 逐元素运算错误推迟到 run()；其他错误(空数组、预算超限等)与行无关，照常抛出
+            callValues.push_back( std::numeric_limits< double >::quiet_NaN() );
+            callStatus.push_back( e.status() );
+        }
+    }
+}
+
+namespace {
+    // 每个线程复用的栈空间，run() 本身不做堆分配；float 与 double 各用一份
+    template < typename T >
+    std::vector< T >& stackScratch() {
+        thread_local std::vector< T > scratch;
+        return scratch;
+    }
+
+    // 返回是否有新的错误
+    template < typename T, typename Bad >
+    inline bool flag( EvalStatus* status, std::size_t n, const T* values, Bad bad, EvalStatus code ) {
+        bool any = false;
+        for ( std::size_t i = 0; i < n; ++i ) {
+            bool hit    = status[ i ] == EvalStatus::OK && bad( values[ i ] );
+            status[ i ] = hit ? code : status[ i ];
+            any         = any || hit;
+        }
+        return any;
+    }
+
+    // 二元运算的结果继承两个操作数的状态，左操作数先计算，它的错误在先
+    inline void merge( EvalStatus* lhs, const EvalStatus* rhs, std::size_t n ) {
+        for ( std::size_t i = 0; i < n; ++i )
+            lhs[ i ] = lhs[ i ] != EvalStatus::OK ? lhs[ i ] : rhs[ i ];
+    }
+
+    // take 为真时返回 a，否则返回 b。用位掩码合成而不是条件表达式，编译器没有向量化时也不会生成依赖数据的跳转
+    template < typename T >
+    inline T blend( bool take, T a, T b ) {
+        using Bits = std::conditional_t< sizeof( T ) == 8, std::uint64_t,
+                                         std::conditional_t< sizeof( T ) == 4, std::uint32_t, std::uint8_t > >;
+        auto mask = static_cast< Bits >( Bits{ 0 } - static_cast< Bits >( take ) );
+        return std::bit_cast< T >(
+            static_cast< Bits >( ( std::bit_cast< Bits >( a ) & mask ) | ( std::bit_cast< Bits >( b ) & ~mask ) ) );
+    }
+
+    template < typename T >
+    T factorial( T val ) {
+        // 171! 超出 double 的范围，35! 超出 float 的范围，不必真的循环
+        constexpr T LIMIT = std::is_same_v< T, float > ? 34 : 170;
+        T intPart         = 0;
+        std::modf( val, &intPart );
+        if ( intPart > LIMIT )
+            return std::numeric_limits< T >::infinity();
+        auto n   = static_cast< unsigned int >( intPart );
+        T result = 1;
+        for ( unsigned int i = 2; i <= n; ++i )
+            result *= static_cast< T >( i );
+        return result;
+    }
+
+    // 以 T 为运算精度执行程序。输入列、常量和 PUSH_CALL 的值在入栈时转换为 T，之后全部按 T 计算；
+    // 第 i 个结果写入 out[i * outStride]。callStatus 为空表示所有 PUSH_CALL 的值都有效
+    template < typename T >
+    void execute( ProgramView program, std::span< const Column > inputs, std::span< const double > callValues,
+                  std::span< const EvalStatus > callStatus, std::size_t offset, std::size_t count, T* out,
+                  std::ptrdiff_t outStride, EvalStatus* status ) {
+        CALC_PROFILE_PHASE( BATCH );
+        std::vector< T >& scratch = stackScratch< T >();
+        std::size_t depth         = std::max< std::size_t >( program.maxDepth, 1 );
+        if ( scratch.size() < depth * BATCH_BLOCK )
+            scratch.resize( depth * BATCH_BLOCK );
+        EvalStatus blockStatus[ BATCH_BLOCK ];
+        // 所有栈槽默认共用 blockStatus(步长为 0)。含 SELECT 的程序需要知道错误属于哪个栈槽，
+        // 选择时才能丢弃未选中分支的错误：块内第一次出错后改为每个栈槽单独记录状态。
+        // 错误很少见，大多数块不必逐条指令合并状态
+        bool masked            = std::any_of( program.code.begin(), program.code.end(),
+                                              []( const Instruction& ins ) { return ins.op == OpCode::SELECT; } );
+        EvalStatus* slotStatus = nullptr;
+        if ( masked ) {
+            std::vector< EvalStatus >& slots = stackScratch< EvalStatus >();
+            if ( slots.size() < depth * BATCH_BLOCK )
+                slots.resize( depth * BATCH_BLOCK );
+            slotStatus = slots.data();
+        }
+
+        for ( std::size_t start = 0; start < count; start += BATCH_BLOCK ) {
+            checkDeadline();
+            std::size_t n   = std::min( BATCH_BLOCK, count - start );
+            std::size_t row = offset + start;
+            std::fill_n( blockStatus, n, EvalStatus::OK );
+            EvalStatus* statusBase = blockStatus;
+            std::size_t statusStep = 0;
+            T* stack               = scratch.data();
+            std::size_t sp         = 0;
+
+            for ( const Instruction& ins : program.code ) {
+                // top: 下一个空位；arg/rhs: 栈顶；lhs: 次栈顶
+                T* top       = stack + sp * BATCH_BLOCK;
+                T* arg       = stack + ( sp >= 1 ? sp - 1 : 0 ) * BATCH_BLOCK;
+                const T* rhs = arg;
+                T* lhs       = stack + ( sp >= 2 ? sp - 2 : 0 ) * BATCH_BLOCK;
+                // 对应栈槽的状态，共用 blockStatus 时都指向它
+                EvalStatus* argStatus = statusBase + ( sp >= 1 ? sp - 1 : 0 ) * statusStep;
+                EvalStatus* lhsStatus = statusBase + ( sp >= 2 ? sp - 2 : 0 ) * statusStep;
+                bool flagged          = false;
+                if ( statusStep != 0 ) {
+                    std::uint32_t arity = operandCount( ins.op );
+                    if ( arity == 0 )
+                        std::fill_n( statusBase + sp * statusStep, n, EvalStatus::OK );
+                    else if ( arity == 2 )
+                        merge( lhsStatus, argStatus, n );
+                }
+                switch ( ins.op ) {
+                case OpCode::PUSH_CONST:
+                    std::fill_n( top, n, static_cast< T >( ins.immediate ) );
+                    ++sp;
+                    break;
+                case OpCode::PUSH_COLUMN: {
+                    const Column& column = inputs[ ins.operand ];
+                    if ( column.stride == 1 ) {
+                        const double* src = column.data + row;
+                        for ( std::size_t i = 0; i < n; ++i )
+                            top[ i ] = static_cast< T >( src[ i ] );
+                    }
+                    else if ( column.stride == 0 ) {
+                        std::fill_n( top, n, static_cast< T >( *column.data ) );
+                    }
+                    else {
+                        const double* src = column.data + static_cast< std::ptrdiff_t >( row ) * column.stride;
+                        for ( std::size_t i = 0; i < n; ++i )
+                            top[ i ] = static_cast< T >( src[ static_cast< std::ptrdiff_t >( i ) * column.stride ] );
+                    }
+                    ++sp;
+                    break;
+                }
+                case OpCode::PUSH_CALL:
+                    std::fill_n( top, n, static_cast< T >( callValues[ ins.operand ] ) );
+                    // 出错的值在每一行都带着它的错误，是否报告取决于最终是否被选中
+                    if ( !callStatus.empty() && callStatus[ ins.operand ] != EvalStatus::OK )
+                        flagged = flag(
+                            statusBase + sp * statusStep, n, top, []( T ) { return true; }, callStatus[ ins.operand ] );
+                    ++sp;
+                    break;
+                case OpCode::ADD:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] += rhs[ i ];
+                    --sp;
+                    break;
+                case OpCode::SUB:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] -= rhs[ i ];
+                    --sp;
+                    break;
+                case OpCode::MUL:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] *= rhs[ i ];
+                    --sp;
+                    break;
+                case OpCode::DIV:
+                    flagged = flag( lhsStatus, n, rhs, []( T v ) { return v == 0; }, EvalStatus::DIVISION_BY_ZERO );
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] /= rhs[ i ];
+                    --sp;
+                    break;
+                case OpCode::POW:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] = std::pow( lhs[ i ], rhs[ i ] );
+                    --sp;
+                    break;
+                case OpCode::MOD:
+                    flagged = flag( lhsStatus, n, rhs, []( T v ) { return v == 0; }, EvalStatus::MODULO_BY_ZERO );
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] = std::fmod( lhs[ i ], rhs[ i ] );
+                    --sp;
+                    break;
+                case OpCode::SQRT:
+                    flagged = flag( argStatus, n, arg, []( T v ) { return v < 0; }, EvalStatus::SQRT_NEGATIVE );
+                    for ( std::size_t i = 0; i < n; ++i )
+                        arg[ i ] = std::sqrt( arg[ i ] );
+                    break;
+                case OpCode::SIN:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        arg[ i ] = std::sin( arg[ i ] );
+                    break;
+                case OpCode::COS:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        arg[ i ] = std::cos( arg[ i ] );
+                    break;
+                case OpCode::TAN:
+                    flagged = flag(
+                        argStatus, n, arg, []( T v ) { return std::cos( v ) == 0; }, EvalStatus::TAN_UNDEFINED );
+                    for ( std::size_t i = 0; i < n; ++i )
+                        arg[ i ] = std::tan( arg[ i ] );
+                    break;
+                case OpCode::LG:
+                    flagged = flag( argStatus, n, arg, []( T v ) { return v <= 0; }, EvalStatus::LG_NON_POSITIVE );
+                    for ( std::size_t i = 0; i < n; ++i )
+                        arg[ i ] = std::log10( arg[ i ] );
+                    break;
+                case OpCode::LN:
+                    flagged = flag( argStatus, n, arg, []( T v ) { return v <= 0; }, EvalStatus::LN_NON_POSITIVE );
+                    for ( std::size_t i = 0; i < n; ++i )
+                        arg[ i ] = std::log( arg[ i ] );
+                    break;
+                case OpCode::FACTORIAL:
+                    flagged = flag( argStatus, n, arg, []( T v ) { return v < 0; }, EvalStatus::FACTORIAL_NEGATIVE );
+                    flagged = flag(
+                                  argStatus, n, arg,
+                                  []( T v ) {
+                                      T intPart = 0;
+                                      return std::isnan( v )
+                                             || std::abs( std::modf( v, &intPart ) ) > static_cast< T >( 1e-10 );
+                                  },
+                                  EvalStatus::FACTORIAL_NON_INTEGER )
+                              || flagged;
+                    for ( std::size_t i = 0; i < n; ++i )
+                        arg[ i ] = argStatus[ i ] == EvalStatus::OK ? factorial( arg[ i ] ) : 0;
+                    break;
+                case OpCode::LT:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] = lhs[ i ] < rhs[ i ] ? T{ 1 } : T{ 0 };
+                    --sp;
+                    break;
+                case OpCode::LE:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] = lhs[ i ] <= rhs[ i ] ? T{ 1 } : T{ 0 };
+                    --sp;
+                    break;
+                case OpCode::GT:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] = lhs[ i ] > rhs[ i ] ? T{ 1 } : T{ 0 };
+                    --sp;
+                    break;
+                case OpCode::GE:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] = lhs[ i ] >= rhs[ i ] ? T{ 1 } : T{ 0 };
+                    --sp;
+                    break;
+                case OpCode::EQ:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] = lhs[ i ] == rhs[ i ] ? T{ 1 } : T{ 0 };
+                    --sp;
+                    break;
+                case OpCode::NE:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] = lhs[ i ] != rhs[ i ] ? T{ 1 } : T{ 0 };
+                    --sp;
+                    break;
+                case OpCode::MIN:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] = std::min( lhs[ i ], rhs[ i ] );
+                    --sp;
+                    break;
+                case OpCode::MAX:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        lhs[ i ] = std::max( lhs[ i ], rhs[ i ] );
+                    --sp;
+                    break;
+                case OpCode::ABS:
+                    for ( std::size_t i = 0; i < n; ++i )
+                        arg[ i ] = std::abs( arg[ i ] );
+                    break;
+                case OpCode::SELECT: {
+                    // 两个分支都已算出，逐元素选择，没有依赖数据的跳转；状态先于值选择，因为值会覆盖 cond
+                    T* cond                = stack + ( sp - 3 ) * BATCH_BLOCK;
+                    EvalStatus* condStatus = statusBase + ( sp - 3 ) * statusStep;
+                    if ( statusStep != 0 ) {
+                        for ( std::size_t i = 0; i < n; ++i ) {
+                            EvalStatus taken = blend( cond[ i ] != 0, lhsStatus[ i ], argStatus[ i ] );
+                            condStatus[ i ]  = blend( condStatus[ i ] == EvalStatus::OK, taken, condStatus[ i ] );
+                        }
+                    }
+                    for ( std::size_t i = 0; i < n; ++i )
+                        cond[ i ] = blend( cond[ i ] != 0, lhs[ i ], rhs[ i ] );
+                    sp -= 2;
+                    break;
+                }
+                }
+                if ( flagged && masked && statusStep == 0 ) {
+                    // 块内第一次出错：此前的栈槽都没有错误，错误只属于刚写入的栈顶
+                    for ( std::size_t slot = 0; slot + 1 < sp; ++slot )
+                        std::fill_n( slotStatus + slot * BATCH_BLOCK, n, EvalStatus::OK );
+                    std::copy_n( blockStatus, n, slotStatus + ( sp - 1 ) * BATCH_BLOCK );
+                    statusBase = slotStatus;
+                    statusStep = BATCH_BLOCK;
+                }
+            }
+
+            T* result = out + static_cast< std::ptrdiff_t >( start ) * outStride;
+            if ( outStride == 1 ) {
+                std::copy_n( stack, n, result );
+            }
+            else {
+                for ( std::size_t i = 0; i < n; ++i )
+                    result[ static_cast< std::ptrdiff_t >( i ) * outStride ] = stack[ i ];
+            }
+            // 结果位于第 0 个栈槽，它的状态即最终状态
+            for ( std::size_t i = 0; i < n; ++i ) {
+                if ( statusBase[ i ] == EvalStatus::OK )
+                    continue;
+                if ( !status )
+                    throw EvaluationError( statusBase[ i ] );
+                result[ static_cast< std::ptrdiff_t >( i ) * outStride ] = std::numeric_limits< T >::quiet_NaN();
+            }
+            if ( status )
+                std::copy_n( statusBase, n, status + start );
+        }
+    }
+}  // namespace
+
+void BatchEvaluator::run( std::size_t offset, std::size_t count, double* out, EvalStatus* status ) const {
+    execute( ProgramView{ program.code, program.maxDepth }, inputs, callValues, callStatus, offset, count, out, 1,
+             status );
+}
+
+void BatchEvaluator::run( std::size_t offset, std::size_t count, float* out, EvalStatus* status ) const {
+    execute( ProgramView{ program.code, program.maxDepth }, inputs, callValues, callStatus, offset, count, out, 1,
+             status );
+}
+
+void runProgram( ProgramView program, std::span< const Column > inputs, std::span< const double > callValues,
+                 std::size_t offset, std::size_t count, double* out, EvalStatus* status ) {
+    execute( program, inputs, callValues, {}, offset, count, out, 1, status );
+}
+
+void runProgram( ProgramView program, std::span< const Column > inputs, std::span< const double > callValues,
+                 std::size_t offset, std::size_t count, float* out, EvalStatus* status ) {
+    execute( program, inputs, callValues, {}, offset, count, out, 1, status );
+}
+
+void runProgram( ProgramView program, std::span< const Column > inputs, std::span< const double > callValues,
+                 std::size_t offset, std::size_t count, double* out, std::ptrdiff_t outStride, EvalStatus* status ) {
+    execute( program, inputs, callValues, {}, offset, count, out, outStride, status );
+}
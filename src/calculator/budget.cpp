@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <format>
+#include <simple_calculator/budget.hpp>
+#include <simple_calculator/calculator.hpp>
+
+const char* budgetErrorName( BudgetError error ) {
+    switch ( error ) {
+    case BudgetError::INPUT_TOO_LARGE:
+        return "input too large";
+    case BudgetError::TOO_MANY_TOKENS:
+        return "too many tokens";
+    case BudgetError::TOO_DEEP:
+        return "nested too deeply";
+    case BudgetError::TOO_EXPENSIVE:
+        return "too expensive";
+    case BudgetError::DEADLINE_EXCEEDED:
+        return "deadline exceeded";
+    }
+    return "unknown";
+}
+
+void CostEstimator::enter() {
+    ++own.nodes;
+    frames.push_back( chained );
+    level += chained ? 0 : 1;
+    chained   = false;
+    own.depth = std::max( own.depth, level );
+}
+
+void CostEstimator::leave() {
+    if ( !frames.back() )
+        --level;
+    frames.pop_back();
+}
+
+void CostEstimator::continueChain() {
+    chained = true;
+}
+
+void CostEstimator::operation( double weight ) {
+    own.cost += weight;
+    if ( weight >= cost_weight::TRANSCENDENTAL )
+        own.transcendentalCalls += 1;
+}
+
+void CostEstimator::factorial( double iterations ) {
+    own.cost += iterations;
+    own.factorialIterations += iterations;
+}
+
+void CostEstimator::array( std::size_t size ) {
+    length = std::max( length, size );
+}
+
+void CostEstimator::aggregate( const CostEstimator& body ) {
+    // 空数组也至少按一个元素计
+    auto n = static_cast< double >( std::max< std::size_t >( body.length, 1 ) );
+    nested.nodes += body.own.nodes + body.nested.nodes;
+    nested.depth = std::max( nested.depth, level + std::max( body.own.depth, body.nested.depth ) );
+    nested.cost += body.own.cost * n + body.nested.cost;
+    nested.transcendentalCalls += body.own.transcendentalCalls * n + body.nested.transcendentalCalls;
+    nested.factorialIterations += body.own.factorialIterations * n + body.nested.factorialIterations;
+}
+
+ExpressionCost CostEstimator::result() const {
+    return ExpressionCost{
+        .nodes               = own.nodes + nested.nodes,
+        .depth               = std::max( own.depth, nested.depth ),
+        .factorialIterations = own.factorialIterations + nested.factorialIterations,
+        .transcendentalCalls = own.transcendentalCalls + nested.transcendentalCalls,
+        .cost                = own.cost + nested.cost,
+    };
+}
+
+ExpressionCost estimateCost( const ASTNode& root ) {
+    CostEstimator estimator;
+    root.estimate( estimator );
+    return estimator.result();
+}
+
+ExpressionCost checkBudget( const ASTNode& root, const ResourceBudget& budget ) {
+    ExpressionCost cost = estimateCost( root );
+    if ( cost.depth > budget.maxDepth )
+        throw BudgetExceeded( BudgetError::TOO_DEEP,
+                              std::format( "Expression depth {} exceeds the limit of {}", cost.depth, budget.maxDepth ) );
+    if ( cost.cost > budget.maxCost )
+        throw BudgetExceeded( BudgetError::TOO_EXPENSIVE, std::format( "Estimated cost {:.0f} exceeds the limit of {:.0f}",
+                                                                       cost.cost, budget.maxCost ) );
+    return cost;
+}
+
+double evaluateWithBudget( const std::string& input, const ResourceBudget& budget,
+                           const std::function< std::unique_ptr< ASTNode >( const std::string& ) >& resolver ) {
+    if ( input.size() > budget.maxInputBytes )
+        throw BudgetExceeded( BudgetError::INPUT_TOO_LARGE, std::format( "Input of {} bytes exceeds the limit of {}",
+                                                                         input.size(), budget.maxInputBytes ) );
+    // 时限从收到请求开始计算，解析也计入
+    DeadlineScope deadline( budget.deadline );
+    Lexer lexer( input );
+    lexer.limitTokens( budget.maxTokens );
+    Parser parser( lexer, resolver );
+    auto ast = parser.parse();
+    checkBudget( *ast, budget );
+    return ast->evaluate();
+}
+
+namespace {
+    thread_local std::optional< std::chrono::steady_clock::time_point > activeDeadline;
+}  // namespace
+
+DeadlineScope::DeadlineScope( std::chrono::nanoseconds timeout )
+    : DeadlineScope( std::optional( std::chrono::steady_clock::now() + timeout ) ) {}
+
+DeadlineScope::DeadlineScope( std::optional< std::chrono::steady_clock::time_point > deadline )
+    : previous( activeDeadline ) {
+    if ( deadline && ( !activeDeadline || *deadline < *activeDeadline ) )
+        activeDeadline = deadline;
+}
+
+DeadlineScope::~DeadlineScope() {
+    activeDeadline = previous;
+}
+
+std::optional< std::chrono::steady_clock::time_point > currentDeadline() {
+    return activeDeadline;
+}
+
+void checkDeadline() {
+    if ( activeDeadline && std::chrono::steady_clock::now() > *activeDeadline )
+        throw BudgetExceeded( BudgetError::DEADLINE_EXCEEDED, "Evaluation deadline exceeded" );
+}
@@ -0,0 +1,449 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <simple_calculator/bundle.hpp>
+#include <simple_calculator/calculator.hpp>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    constexpr char MAGIC[ 4 ]           = { 'S', 'C', 'F', 'B' };
+    constexpr std::uint32_t ENDIAN_MARK = 0x01020304;
+    constexpr std::size_t SECTION_ALIGN = 16;
+
+    struct StringRef {
+        std::uint32_t offset;  // 相对字符串池
+        std::uint32_t length;
+    };
+
+    struct Header {
+        char magic[ 4 ];
+        std::uint32_t byteOrder;
+        std::uint32_t version;
+        std::uint32_t formulaCount;
+        std::uint32_t slotCount;  // 2 的幂
+        std::uint32_t reserved;
+        std::uint64_t fileSize;
+        std::uint64_t entriesOffset;
+        std::uint64_t slotsOffset;
+        std::uint64_t codeOffset;
+        std::uint64_t columnsOffset;
+        std::uint64_t stringsOffset;
+        std::uint64_t payloadChecksum;  // 从指令段到文件末尾
+        std::uint64_t indexChecksum;    // 目录和哈希表(含段间填充)
+        std::uint64_t headerChecksum;   // 本字段之前的文件头
+    };
+
+    struct Entry {
+        std::uint64_t nameHash;
+        StringRef name;
+        std::uint32_t codeIndex;  // 以指令为单位
+        std::uint32_t codeLength;
+        std::uint32_t columnIndex;  // 以 StringRef 为单位
+        std::uint32_t columnCount;
+        std::uint32_t maxDepth;
+        std::uint32_t reserved;
+    };
+
+    // 文件中的每个字节都被某个校验和覆盖
+    static_assert( sizeof( Header ) == 96 && sizeof( Entry ) == 40 && sizeof( StringRef ) == 8 );
+
+    // FNV-1a
+    constexpr std::uint64_t FNV_OFFSET = 0xcbf29ce484222325ULL;
+    std::uint64_t fnv1a( const void* bytes, std::size_t size, std::uint64_t hash = FNV_OFFSET ) {
+        const auto* p = static_cast< const unsigned char* >( bytes );
+        for ( std::size_t i = 0; i < size; ++i ) {
+            hash ^= p[ i ];
+            hash *= 0x100000001b3ULL;
+        }
+        return hash;
+    }
+    std::uint64_t hashName( std::string_view name ) {
+        return fnv1a( name.data(), name.size() );
+    }
+
+    std::size_t alignUp( std::size_t offset ) {
+        return ( offset + SECTION_ALIGN - 1 ) / SECTION_ALIGN * SECTION_ALIGN;
+    }
+
+    std::uint32_t checkedU32( std::size_t value ) {
+        if ( value > std::numeric_limits< std::uint32_t >::max() )
+            throw std::runtime_error( "Formula bundle too large" );
+        return static_cast< std::uint32_t >( value );
+    }
+
+    [[noreturn]] void corrupt( const std::string& what ) {
+        throw std::runtime_error( "Invalid formula bundle: " + what );
+    }
+
+    // 指令结构检查：操作码合法、列号在范围内、栈不下溢且深度不超过 maxDepth，结束时恰好剩一个值
+    bool validCode( std::span< const Instruction > code, std::size_t columns, std::uint32_t maxDepth ) {
+        std::uint32_t depth = 0;
+        for ( const Instruction& ins : code ) {
+            switch ( ins.op ) {
+            case OpCode::PUSH_CONST:
+                ++depth;
+                break;
+            case OpCode::PUSH_COLUMN:
+                if ( ins.operand >= columns )
+                    return false;
+                ++depth;
+                break;
+            case OpCode::ADD:
+            case OpCode::SUB:
+            case OpCode::MUL:
+            case OpCode::DIV:
+            case OpCode::POW:
+            case OpCode::MOD:
+            case OpCode::LT:
+            case OpCode::LE:
+            case OpCode::GT:
+            case OpCode::GE:
+            case OpCode::EQ:
+            case OpCode::NE:
+            case OpCode::MIN:
+            case OpCode::MAX:
+                if ( depth < 2 )
+                    return false;
+                --depth;
+                break;
+            case OpCode::SQRT:
+            case OpCode::SIN:
+            case OpCode::COS:
+            case OpCode::TAN:
+            case OpCode::LG:
+            case OpCode::LN:
+            case OpCode::FACTORIAL:
+            case OpCode::ABS:
+                if ( depth < 1 )
+                    return false;
+                break;
+            case OpCode::SELECT:
+                if ( depth < 3 )
+                    return false;
+                depth -= 2;
+                break;
+            default:  // PUSH_CALL 和未知操作码
+                return false;
+            }
+            if ( depth > maxDepth )
+                return false;
+        }
+        return depth == 1;
+    }
+
+    const Header& header( const std::byte* base ) {
+        return *reinterpret_cast< const Header* >( base );
+    }
+    const Entry* entries( const std::byte* base ) {
+        return reinterpret_cast< const Entry* >( base + header( base ).entriesOffset );
+    }
+    const std::uint32_t* slots( const std::byte* base ) {
+        return reinterpret_cast< const std::uint32_t* >( base + header( base ).slotsOffset );
+    }
+    const Instruction* instructions( const std::byte* base ) {
+        return reinterpret_cast< const Instruction* >( base + header( base ).codeOffset );
+    }
+    const StringRef* columnRefs( const std::byte* base ) {
+        return reinterpret_cast< const StringRef* >( base + header( base ).columnsOffset );
+    }
+    std::string_view string( const std::byte* base, StringRef ref ) {
+        return { reinterpret_cast< const char* >( base + header( base ).stringsOffset + ref.offset ), ref.length };
+    }
+
+    // 每个线程复用的标量参数列
+    thread_local std::vector< Column > scalarColumns;
+}  // namespace
+
+void BundleWriter::add( const std::string& name, const std::string& expression ) {
+    std::vector< std::string > columns;
+    double unused = 0;
+    Lexer lexer( expression );
+    Parser parser( lexer, [ &columns, &unused ]( const std::string& ref ) -> std::unique_ptr< ASTNode > {
+        if ( std::find( columns.begin(), columns.end(), ref ) == columns.end() )
+            columns.push_back( ref );
+        return std::make_unique< VariableNode >( ref, &unused );
+    } );
+    auto ast = parser.parse();
+    add( name, compileBatch( *ast, std::move( columns ) ) );
+}
+
+void BundleWriter::add( const std::string& name, const BatchProgram& program ) {
+    bool portable = std::none_of( program.code.begin(), program.code.end(),
+                                  []( const Instruction& ins ) { return ins.op == OpCode::PUSH_CALL; } ) &&
+                    std::none_of( program.sources.begin(), program.sources.end(),
+                                  []( const auto* source ) { return source != nullptr; } );
+    if ( !portable )
+        throw std::runtime_error( "Formula cannot be stored in a bundle (uses arrays or aggregates): " + name );
+    if ( names.contains( name ) )
+        throw std::runtime_error( "Duplicate formula name: " + name );
+
+    BatchProgram copy = program;
+    if ( fold )
+        foldConstants( copy );
+    names.insert( name );
+    formulas.push_back( Formula{ name, std::move( copy.columns ), std::move( copy.code ), copy.maxDepth } );
+}
+
+std::vector< std::byte > BundleWriter::serialize() const {
+    std::size_t instructionCount = 0;
+    std::size_t columnCount      = 0;
+    std::string strings;
+    for ( const Formula& f : formulas ) {
+        instructionCount += f.code.size();
+        columnCount += f.columns.size();
+    }
+    auto intern = [ &strings ]( const std::string& s ) {
+        StringRef ref{ checkedU32( strings.size() ), checkedU32( s.size() ) };
+        strings += s;
+        return ref;
+    };
+
+    Header head{};
+    std::memcpy( head.magic, MAGIC, sizeof( MAGIC ) );
+    head.byteOrder     = ENDIAN_MARK;
+    head.version       = BUNDLE_VERSION;
+    head.formulaCount  = checkedU32( formulas.size() );
+    head.slotCount     = checkedU32( std::bit_ceil( std::max< std::size_t >( formulas.size() * 2, 1 ) ) );
+    head.entriesOffset = alignUp( sizeof( Header ) );
+    head.slotsOffset   = alignUp( head.entriesOffset + formulas.size() * sizeof( Entry ) );
+    head.codeOffset    = alignUp( head.slotsOffset + head.slotCount * sizeof( std::uint32_t ) );
+    head.columnsOffset = alignUp( head.codeOffset + instructionCount * sizeof( Instruction ) );
+    head.stringsOffset = alignUp( head.columnsOffset + columnCount * sizeof( StringRef ) );
+
+    std::vector< Entry > table;
+    std::vector< std::uint32_t > hashSlots( head.slotCount, 0 );
+    std::vector< Instruction > code;
+    std::vector< StringRef > columns;
+    table.reserve( formulas.size() );
+    code.reserve( instructionCount );
+    columns.reserve( columnCount );
+    for ( const Formula& f : formulas ) {
+        Entry entry{};
+        entry.nameHash    = hashName( f.name );
+        entry.name        = intern( f.name );
+        entry.codeIndex   = checkedU32( code.size() );
+        entry.codeLength  = checkedU32( f.code.size() );
+        entry.columnIndex = checkedU32( columns.size() );
+        entry.columnCount = checkedU32( f.columns.size() );
+        entry.maxDepth    = f.maxDepth;
+        code.insert( code.end(), f.code.begin(), f.code.end() );
+        for ( const std::string& column : f.columns )
+            columns.push_back( intern( column ) );
+
+        // 线性探测
+        std::size_t slot = entry.nameHash & ( head.slotCount - 1 );
+        while ( hashSlots[ slot ] != 0 )
+            slot = ( slot + 1 ) & ( head.slotCount - 1 );
+        hashSlots[ slot ] = checkedU32( table.size() + 1 );
+        table.push_back( entry );
+    }
+    head.fileSize = head.stringsOffset + strings.size();
+
+    std::vector< std::byte > bytes( head.fileSize );
+    auto put = [ &bytes ]( std::uint64_t offset, const void* src, std::size_t size ) {
+        if ( size > 0 )
+            std::memcpy( bytes.data() + offset, src, size );
+    };
+    put( 0, &head, sizeof( head ) );
+    put( head.entriesOffset, table.data(), table.size() * sizeof( Entry ) );
+    put( head.slotsOffset, hashSlots.data(), hashSlots.size() * sizeof( std::uint32_t ) );
+    put( head.codeOffset, code.data(), code.size() * sizeof( Instruction ) );
+    put( head.columnsOffset, columns.data(), columns.size() * sizeof( StringRef ) );
+    put( head.stringsOffset, strings.data(), strings.size() );
+    head.payloadChecksum = fnv1a( bytes.data() + head.codeOffset, head.fileSize - head.codeOffset );
+    head.indexChecksum   = fnv1a( bytes.data() + head.entriesOffset, head.codeOffset - head.entriesOffset );
+    head.headerChecksum  = fnv1a( &head, offsetof( Header, headerChecksum ) );
+    put( 0, &head, sizeof( head ) );
+    return bytes;
+}
+
+void BundleWriter::write( const std::string& path ) const {
+    auto bytes = serialize();
+    std::ofstream out( path, std::ios::binary | std::ios::trunc );
+    out.write( reinterpret_cast< const char* >( bytes.data() ), static_cast< std::streamsize >( bytes.size() ) );
+    if ( !out )
+        throw std::runtime_error( "Cannot write formula bundle: " + path );
+}
+
+std::string_view BundleFormula::name() const {
+    return string( base, static_cast< const Entry* >( entry )->name );
+}
+
+std::size_t BundleFormula::columnCount() const {
+    return static_cast< const Entry* >( entry )->columnCount;
+}
+
+std::string_view BundleFormula::column( std::size_t i ) const {
+    const auto* e = static_cast< const Entry* >( entry );
+    if ( i >= e->columnCount )
+        throw std::out_of_range( "Column index out of range" );
+    return string( base, columnRefs( base )[ e->columnIndex + i ] );
+}
+
+ProgramView BundleFormula::program() const {
+    const auto* e = static_cast< const Entry* >( entry );
+    return ProgramView{ std::span( instructions( base ) + e->codeIndex, e->codeLength ), e->maxDepth };
+}
+
+void BundleFormula::evaluate( std::span< const Column > columns, std::size_t offset, std::size_t count, double* out,
+                              EvalStatus* status ) const {
+    if ( columns.size() < columnCount() )
+        throw std::invalid_argument( "Formula needs " + std::to_string( columnCount() ) + " columns" );
+    runProgram( program(), columns, {}, offset, count, out, status );
+}
+
+double BundleFormula::operator()( std::span< const double > args ) const {
+    if ( args.size() < columnCount() )
+        throw std::invalid_argument( "Formula needs " + std::to_string( columnCount() ) + " arguments" );
+    scalarColumns.resize( args.size() );
+    for ( std::size_t i = 0; i < args.size(); ++i )
+        scalarColumns[ i ] = Column{ &args[ i ], 0 };
+    double result = 0;
+    runProgram( program(), scalarColumns, {}, 0, 1, &result );
+    return result;
+}
+
+FormulaBundle::FormulaBundle( MappedFile mapped, std::span< const std::byte > bytes, BundleCheck check )
+    : file( std::move( mapped ) ), data( bytes.data() ), length( bytes.size() ) {
+    if ( reinterpret_cast< std::uintptr_t >( data ) % SECTION_ALIGN != 0 )
+        corrupt( "data is not 16-byte aligned" );
+    if ( length < sizeof( Header ) )
+        corrupt( "file too small" );
+    const Header& head = header( data );
+    if ( std::memcmp( head.magic, MAGIC, sizeof( MAGIC ) ) != 0 )
+        corrupt( "bad magic" );
+    if ( head.byteOrder != ENDIAN_MARK )
+        corrupt( "byte order mismatch" );
+    if ( head.version != BUNDLE_VERSION )
+        corrupt( "unsupported version " + std::to_string( head.version ) );
+    if ( head.headerChecksum != fnv1a( &head, offsetof( Header, headerChecksum ) ) )
+        corrupt( "header checksum mismatch" );
+    if ( head.fileSize != length )
+        corrupt( "file size mismatch (truncated?)" );
+
+    // 各段首尾相接、对齐且不越界
+    auto section = [ & ]( std::uint64_t begin, std::uint64_t extent, std::uint64_t next ) {
+        if ( begin % SECTION_ALIGN != 0 || begin > next || extent > next - begin )
+            corrupt( "bad section layout" );
+    };
+    if ( !std::has_single_bit( head.slotCount ) || head.slotCount < std::uint64_t{ head.formulaCount } * 2 )
+        corrupt( "bad hash table size" );
+    section( head.entriesOffset, std::uint64_t{ head.formulaCount } * sizeof( Entry ), head.slotsOffset );
+    section( head.slotsOffset, std::uint64_t{ head.slotCount } * sizeof( std::uint32_t ), head.codeOffset );
+    section( head.codeOffset, 0, head.columnsOffset );
+    section( head.columnsOffset, 0, head.stringsOffset );
+    section( head.stringsOffset, 0, length );
+
+    const Entry* table = entries( data );
+    if ( head.indexChecksum != fnv1a( data + head.entriesOffset, head.codeOffset - head.entriesOffset ) )
+        corrupt( "index checksum mismatch" );
+
+    std::uint64_t codeCount   = ( head.columnsOffset - head.codeOffset ) / sizeof( Instruction );
+    std::uint64_t columnCount = ( head.stringsOffset - head.columnsOffset ) / sizeof( StringRef );
+    std::uint64_t stringBytes = length - head.stringsOffset;
+    auto inRange = []( std::uint64_t begin, std::uint64_t count, std::uint64_t limit ) {
+        return begin <= limit && count <= limit - begin;
+    };
+    std::uint32_t used = 0;
+    for ( std::uint32_t i = 0; i < head.slotCount; ++i ) {
+        if ( slots( data )[ i ] > head.formulaCount )
+            corrupt( "bad hash slot" );
+        used += slots( data )[ i ] != 0 ? 1U : 0U;
+    }
+    if ( used != head.formulaCount )
+        corrupt( "bad hash table" );
+    for ( std::uint32_t i = 0; i < head.formulaCount; ++i ) {
+        const Entry& e = table[ i ];
+        if ( !inRange( e.name.offset, e.name.length, stringBytes ) ||
+             !inRange( e.codeIndex, e.codeLength, codeCount ) ||
+             !inRange( e.columnIndex, e.columnCount, columnCount ) )
+            corrupt( "formula " + std::to_string( i ) + " out of bounds" );
+        for ( std::uint32_t c = 0; c < e.columnCount; ++c ) {
+            StringRef ref = columnRefs( data )[ e.columnIndex + c ];
+            if ( !inRange( ref.offset, ref.length, stringBytes ) )
+                corrupt( "column name out of bounds" );
+        }
+    }
+
+    if ( check == BundleCheck::INDEX ) {
+        validated = std::make_unique< std::atomic< bool >[] >( head.formulaCount );
+        return;
+    }
+    if ( head.payloadChecksum != fnv1a( data + head.codeOffset, length - head.codeOffset ) )
+        corrupt( "payload checksum mismatch" );
+    for ( std::uint32_t i = 0; i < head.formulaCount; ++i ) {
+        BundleFormula formula( data, &table[ i ] );
+        ProgramView program = formula.program();
+        if ( !validCode( program.code, formula.columnCount(), program.maxDepth ) )
+            corrupt( "malformed code in formula " + std::string( formula.name() ) );
+    }
+}
+
+BundleFormula FormulaBundle::checked( std::size_t i ) const {
+    BundleFormula formula( data, entries( data ) + i );
+    // 并发首次取出同一个公式时可能重复检查，结果相同
+    if ( validated && !validated[ i ].load( std::memory_order_acquire ) ) {
+        ProgramView program = formula.program();
+        if ( !validCode( program.code, formula.columnCount(), program.maxDepth ) )
+            corrupt( "malformed code in formula " + std::string( formula.name() ) );
+        validated[ i ].store( true, std::memory_order_release );
+    }
+    return formula;
+}
+
+FormulaBundle FormulaBundle::open( const std::string& path, BundleCheck check ) {
+    MappedFile mapped( path );
+    auto bytes = mapped.span();
+    return FormulaBundle( std::move( mapped ), bytes, check );
+}
+
+FormulaBundle FormulaBundle::view( std::span< const std::byte > bytes, BundleCheck check ) {
+    return FormulaBundle( MappedFile(), bytes, check );
+}
+
+FormulaBundle::FormulaBundle( FormulaBundle&& other ) noexcept
+    : file( std::move( other.file ) ), data( std::exchange( other.data, nullptr ) ),
+      length( std::exchange( other.length, 0 ) ), validated( std::move( other.validated ) ) {}
+
+FormulaBundle& FormulaBundle::operator=( FormulaBundle&& other ) noexcept {
+    if ( this != &other ) {
+        file   = std::move( other.file );
+        data   = std::exchange( other.data, nullptr );
+        length    = std::exchange( other.length, 0 );
+        validated = std::move( other.validated );
+    }
+    return *this;
+}
+
+std::size_t FormulaBundle::size() const {
+    return data ? header( data ).formulaCount : 0;
+}
+
+BundleFormula FormulaBundle::at( std::size_t i ) const {
+    if ( i >= size() )
+        throw std::out_of_range( "Formula index out of range" );
+    return checked( i );
+}
+
+std::optional< BundleFormula > FormulaBundle::find( std::string_view name ) const {
+    if ( !data )
+        return std::nullopt;
+    const Header& head        = header( data );
+    const Entry* table        = entries( data );
+    const std::uint32_t* hash = slots( data );
+    std::uint64_t key         = hashName( name );
+    std::uint32_t mask        = head.slotCount - 1;
+    // 打开时已检查槽位中至少有一半为空，探测一定会终止
+    for ( std::uint64_t slot = key & mask;; slot = ( slot + 1 ) & mask ) {
+        std::uint32_t index = hash[ slot ];
+        if ( index == 0 )
+            return std::nullopt;
+        const Entry& e = table[ index - 1 ];
+        if ( e.nameHash == key && string( data, e.name ) == name )
+            return checked( index - 1 );
+    }
+}
@@ -0,0 +1,200 @@
+#include <algorithm>
+#include <simple_calculator/formula_graph.hpp>
+#include <stdexcept>
+
+FormulaGraph::FormulaGraph( std::size_t threads ) : pool( threads ) {}
+
+FormulaGraph::~FormulaGraph() = default;
+
+std::size_t FormulaGraph::findOrCreate( const std::string& name ) {
+    auto it = index.find( name );
+    if ( it != index.end() )
+        return it->second;
+    auto node  = std::make_unique< Node >();
+    node->name = name;
+    nodes.push_back( std::move( node ) );
+    index.emplace( name, nodes.size() - 1 );
+    return nodes.size() - 1;
+}
+
+const FormulaGraph::Node& FormulaGraph::lookup( const std::string& name ) const {
+    auto it = index.find( name );
+    if ( it == index.end() )
+        throw std::runtime_error( "Unknown formula: " + name );
+    return *nodes[ it->second ];
+}
+
+bool FormulaGraph::reaches( std::size_t from, std::size_t target ) const {
+    std::vector< bool > visited( nodes.size(), false );
+    std::vector< std::size_t > stack{ from };
+    while ( !stack.empty() ) {
+        std::size_t id = stack.back();
+        stack.pop_back();
+        if ( id == target )
+            return true;
+        if ( visited[ id ] )
+            continue;
+        visited[ id ] = true;
+        for ( std::size_t dep : nodes[ id ]->dependencies )
+            stack.push_back( dep );
+    }
+    return false;
+}
+
+void FormulaGraph::markDirty( std::size_t id ) {
+    std::vector< std::size_t > stack{ id };
+    while ( !stack.empty() ) {
+        Node& node = *nodes[ stack.back() ];
+        stack.pop_back();
+        if ( node.dirty )
+            continue;
+        node.dirty = true;
+        dirtyNodes.push_back( index.at( node.name ) );
+        for ( std::size_t dependent : node.dependents )
+            stack.push_back( dependent );
+    }
+}
+
+void FormulaGraph::setInput( const std::string& name, double value ) {
+    std::size_t id = findOrCreate( name );
+    Node& node     = *nodes[ id ];
+    if ( node.kind == Kind::FORMULA ) {
+        for ( std::size_t dep : node.dependencies )
+            std::erase( nodes[ dep ]->dependents, id );
+        node.dependencies.clear();
+        node.ast.reset();
+    }
+    node.kind  = Kind::INPUT;
+    node.value = value;
+    node.error.reset();
+    for ( std::size_t dependent : node.dependents )
+        markDirty( dependent );
+}
+
+void FormulaGraph::define( const std::string& name, const std::string& formula ) {
+    std::size_t id = findOrCreate( name );
+
+    std::vector< std::size_t > dependencies;
+    Lexer lexer( formula );
+    Parser parser( lexer, [ this, &dependencies ]( const std::string& ref ) -> std::unique_ptr< ASTNode > {
+        std::size_t dep = findOrCreate( ref );
+        dependencies.push_back( dep );
+        return std::make_unique< VariableNode >( ref, &nodes[ dep ]->value );
+    } );
+    auto ast = parser.parse();
+
+    std::sort( dependencies.begin(), dependencies.end() );
+    dependencies.erase( std::unique( dependencies.begin(), dependencies.end() ), dependencies.end() );
+    for ( std::size_t dep : dependencies ) {
+        if ( reaches( dep, id ) )
+            throw std::runtime_error( "Circular reference: " + name + " -> " + nodes[ dep ]->name );
+    }
+
+    Node& node = *nodes[ id ];
+    for ( std::size_t dep : node.dependencies )
+        std::erase( nodes[ dep ]->dependents, id );
+    for ( std::size_t dep : dependencies )
+        nodes[ dep ]->dependents.push_back( id );
+    node.kind         = Kind::FORMULA;
+    node.ast          = std::move( ast );
+    node.dependencies = std::move( dependencies );
+    // 已经是脏的节点已在 dirtyNodes 中且下游都已标记，不能再入队一次，否则重算时入度会被重复扣减
+    markDirty( id );
+}
+
+void FormulaGraph::evaluateNode( Node& node ) {
+    for ( std::size_t dep : node.dependencies ) {
+        const Node& source = *nodes[ dep ];
+        if ( source.kind == Kind::UNDEFINED ) {
+            node.error = "Undefined reference: " + source.name;
+            return;
+        }
+        if ( source.error ) {
+            node.error = "Error in dependency: " + source.name;
+            return;
+        }
+    }
+    try {
+        node.value = node.ast->evaluate();
+        node.error.reset();
+    }
+    catch ( const std::exception& e ) {
+        node.error = e.what();
+    }
+}
+
+void FormulaGraph::recalculate() {
+    // 只有公式需要重算；在标记后被改成输入的节点直接清除脏标记
+    std::vector< std::size_t > pending;
+    for ( std::size_t id : dirtyNodes ) {
+        if ( nodes[ id ]->kind == Kind::FORMULA )
+            pending.push_back( id );
+        else
+            nodes[ id ]->dirty = false;
+    }
+    dirtyNodes.clear();
+
+    // 在脏子图上做分层拓扑排序(Kahn)：入度只统计同样为脏的依赖
+    std::unordered_map< std::size_t, std::size_t > indegree;
+    for ( std::size_t id : pending ) {
+        std::size_t count = 0;
+        for ( std::size_t dep : nodes[ id ]->dependencies ) {
+            if ( nodes[ dep ]->dirty && nodes[ dep ]->kind == Kind::FORMULA )
+                ++count;
+        }
+        indegree[ id ] = count;
+    }
+
+    std::vector< std::size_t > wave;
+    for ( std::size_t id : pending ) {
+        if ( indegree[ id ] == 0 )
+            wave.push_back( id );
+    }
+
+    std::size_t waves      = 0;
+    std::size_t recomputed = 0;
+    while ( !wave.empty() ) {
+        pool.parallelFor(
+            wave.size(),
+            [ this, &wave ]( std::size_t begin, std::size_t end ) {
+                for ( std::size_t i = begin; i < end; ++i )
+                    evaluateNode( *nodes[ wave[ i ] ] );
+            },
+            16 );
+        ++waves;
+        recomputed += wave.size();
+
+        std::vector< std::size_t > next;
+        for ( std::size_t id : wave ) {
+            nodes[ id ]->dirty = false;
+            for ( std::size_t dependent : nodes[ id ]->dependents ) {
+                auto it = indegree.find( dependent );
+                if ( it != indegree.end() && --it->second == 0 )
+                    next.push_back( dependent );
+            }
+        }
+        wave = std::move( next );
+    }
+
+    statistics.lastRecomputed = recomputed;
+    statistics.lastWaves      = waves;
+    statistics.totalRecomputed += recomputed;
+}
+
+bool FormulaGraph::contains( const std::string& name ) const {
+    auto it = index.find( name );
+    return it != index.end() && nodes[ it->second ]->kind != Kind::UNDEFINED;
+}
+
+bool FormulaGraph::isDirty( const std::string& name ) const {
+    return lookup( name ).dirty;
+}
+
+double FormulaGraph::value( const std::string& name ) const {
+    const Node& node = lookup( name );
+    if ( node.kind == Kind::UNDEFINED )
+        throw std::runtime_error( "Undefined reference: " + name );
+    if ( node.error )
+        throw std::runtime_error( *node.error );
+    return node.value;
+}
@@ -0,0 +1,406 @@
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <condition_variable>
+#include <exception>
+#include <format>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <simple_calculator/batch.hpp>
+#include <simple_calculator/calculator.hpp>
+#include <simple_calculator/ingest.hpp>
+#include <simple_calculator/mapped_file.hpp>
+#include <simple_calculator/thread_pool.hpp>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+
+namespace {
+    constexpr std::size_t BUFFER_ALIGN = 64;
+    // 每个线程池任务求值的行数
+    constexpr std::size_t EVALUATE_GRAIN = 16 * BATCH_BLOCK;
+    constexpr double MISSING             = std::numeric_limits< double >::quiet_NaN();
+
+    struct AlignedDelete {
+        void operator()( double* p ) const {
+            ::operator delete[]( p, std::align_val_t{ BUFFER_ALIGN } );
+        }
+    };
+    using AlignedBuffer = std::unique_ptr< double[], AlignedDelete >;
+
+    AlignedBuffer allocate( std::size_t count ) {
+        return AlignedBuffer(
+            static_cast< double* >( ::operator new[]( count * sizeof( double ), std::align_val_t{ BUFFER_ALIGN } ) ) );
+    }
+
+    void requireLittleEndian() {
+        if constexpr ( std::endian::native != std::endian::little )
+            throw std::runtime_error( "Raw double columns require a little-endian host" );
+    }
+
+    // 表达式中的每个变量都是一个输入列，按首次出现的顺序编号
+    struct Compiled {
+        std::unique_ptr< ASTNode > ast;
+        BatchProgram program;
+    };
+
+    Compiled compile( const std::string& expression ) {
+        std::vector< std::string > names;
+        Lexer lexer( expression );
+        Parser parser( lexer, [ &names ]( const std::string& name ) -> std::unique_ptr< ASTNode > {
+            if ( std::find( names.begin(), names.end(), name ) == names.end() )
+                names.push_back( name );
+            return std::make_unique< VariableNode >( name, &MISSING );
+        } );
+        Compiled compiled;
+        compiled.ast     = parser.parse();
+        compiled.program = compileBatch( *compiled.ast, std::move( names ) );
+        return compiled;
+    }
+
+    // 一块输入：columns 按程序的列顺序指向这一块的第一行
+    struct Chunk {
+        std::vector< AlignedBuffer > buffers;
+        std::vector< Column > columns;
+        std::size_t first = 0;
+        std::size_t rows  = 0;
+    };
+
+    class ChunkSource {
+    public:
+        virtual ~ChunkSource() = default;
+        // 为一块分配缓冲区，返回分配的字节数
+        virtual std::size_t prepare( Chunk& chunk ) = 0;
+        // 读入下一块并返回行数，0 表示数据已经读完。在后台线程上调用
+        virtual std::size_t fill( Chunk& chunk ) = 0;
+        // 这一块已经求值完毕。在求值线程上调用
+        virtual void consumed( const Chunk& chunk ) = 0;
+    };
+
+    class CsvSource : public ChunkSource {
+        MappedFile file;
+        std::string_view text;
+        char delimiter;
+        std::size_t chunkRows;
+        std::vector< std::string > names;          // 按程序的列顺序
+        std::vector< std::size_t > fieldOfSlot;    // 列槽位 -> 字段序号
+        std::vector< std::ptrdiff_t > slotOfField;  // 字段序号 -> 列槽位，-1 表示跳过
+        std::size_t cursor   = 0;
+        std::size_t released = 0;
+        std::size_t line     = 1;
+
+        static std::string_view trim( std::string_view field ) {
+            while ( !field.empty() && ( field.front() == ' ' || field.front() == '\t' ) )
+                field.remove_prefix( 1 );
+            while ( !field.empty() && ( field.back() == ' ' || field.back() == '\t' || field.back() == '\r' ) )
+                field.remove_suffix( 1 );
+            if ( field.size() >= 2 && field.front() == '"' && field.back() == '"' )
+                field = field.substr( 1, field.size() - 2 );
+            return field;
+        }
+
+        double parse( std::string_view field, std::size_t slot ) const {
+            field = trim( field );
+            if ( field.empty() )
+                return MISSING;
+            if ( field.front() == '+' )
+                field.remove_prefix( 1 );
+            double value     = 0;
+            auto [ end, ec ] = std::from_chars( field.data(), field.data() + field.size(), value );
+            if ( ec == std::errc::result_out_of_range )
+                throw std::runtime_error(
+                    std::format( "Number out of range at line {}, column {}: {}", line, names[ slot ], field ) );
+            if ( ec != std::errc() || end != field.data() + field.size() )
+                throw std::runtime_error(
+                    std::format( "Invalid number at line {}, column {}: {}", line, names[ slot ], field ) );
+            return value;
+        }
+
+        // 读一行到 chunk 的第 row 行；空行返回 false
+        bool parseRow( Chunk& chunk, std::size_t row ) {
+            if ( text[ cursor ] == '\n' || ( text[ cursor ] == '\r' && cursor + 1 < text.size() && text[ cursor + 1 ] == '\n' ) ) {
+                cursor = text.find( '\n', cursor ) + 1;
+                ++line;
+                return false;
+            }
+            std::size_t field = 0;
+            for ( ;; ) {
+                std::size_t end = cursor;
+                while ( end < text.size() && text[ end ] != delimiter && text[ end ] != '\n' )
+                    ++end;
+                if ( field < slotOfField.size() && slotOfField[ field ] >= 0 ) {
+                    auto slot                     = static_cast< std::size_t >( slotOfField[ field ] );
+                    chunk.buffers[ slot ][ row ] = parse( text.substr( cursor, end - cursor ), slot );
+                }
+                cursor = end;
+                if ( cursor < text.size() && text[ cursor ] == delimiter ) {
+                    ++cursor;
+                    ++field;
+                    continue;
+                }
+                break;
+            }
+            // 字段不足的行，缺少的列按空字段处理
+            for ( std::size_t slot = 0; slot < fieldOfSlot.size(); ++slot ) {
+                if ( fieldOfSlot[ slot ] > field )
+                    chunk.buffers[ slot ][ row ] = MISSING;
+            }
+            if ( cursor < text.size() )
+                ++cursor;
+            ++line;
+            return true;
+        }
+
+    public:
+        CsvSource( const CsvInput& input, std::vector< std::string > columns, std::size_t rowsPerChunk )
+            : file( input.path ), text( reinterpret_cast< const char* >( file.data() ), file.size() ),
+              delimiter( input.delimiter ), chunkRows( rowsPerChunk ), names( std::move( columns ) ),
+              fieldOfSlot( names.size() ) {
+            std::size_t headerEnd = std::min( text.find( '\n' ), text.size() );
+            std::string_view header = text.substr( 0, headerEnd );
+            std::vector< bool > found( names.size(), false );
+            for ( std::size_t field = 0;; ++field ) {
+                std::size_t end     = std::min( header.find( delimiter ), header.size() );
+                std::string_view name = trim( header.substr( 0, end ) );
+                auto it               = std::find( names.begin(), names.end(), name );
+                std::ptrdiff_t slot   = -1;
+                if ( it != names.end() && !found[ static_cast< std::size_t >( it - names.begin() ) ] ) {
+                    auto index          = static_cast< std::size_t >( it - names.begin() );
+                    found[ index ]      = true;
+                    fieldOfSlot[ index ] = field;
+                    slot                = it - names.begin();
+                }
+                slotOfField.push_back( slot );
+                if ( end == header.size() )
+                    break;
+                header.remove_prefix( end + 1 );
+            }
+            for ( std::size_t i = 0; i < names.size(); ++i ) {
+                if ( !found[ i ] )
+                    throw std::runtime_error( "Unknown column: " + names[ i ] );
+            }
+            cursor = std::min( headerEnd + 1, text.size() );
+            line   = 2;
+        }
+
+        std::size_t prepare( Chunk& chunk ) override {
+            for ( std::size_t i = 0; i < names.size(); ++i ) {
+                chunk.buffers.push_back( allocate( chunkRows ) );
+                chunk.columns.push_back( Column{ chunk.buffers.back().get() } );
+            }
+            return names.size() * chunkRows * sizeof( double );
+        }
+
+        std::size_t fill( Chunk& chunk ) override {
+            std::size_t start = cursor;
+            std::size_t rows  = 0;
+            while ( rows < chunkRows && cursor < text.size() ) {
+                if ( parseRow( chunk, rows ) )
+                    ++rows;
+            }
+            // 解析结果已经在缓冲区里，原文可以立即交还；按上一块的大小预读下一块
+            file.discard( released, cursor - released );
+            released = cursor;
+            file.prefetch( cursor, cursor - start );
+            return rows;
+        }
+
+        void consumed( const Chunk& ) override {}
+    };
+
+    // 原始列文件直接在映射的内存上求值，不需要复制
+    class ColumnFilesSource : public ChunkSource {
+        std::vector< MappedFile > files;  // 按程序的列顺序
+        std::size_t chunkRows;
+        std::size_t total  = 0;
+        std::size_t cursor = 0;
+
+    public:
+        ColumnFilesSource( const ColumnFilesInput& input, const std::vector< std::string >& names,
+                           std::size_t rowsPerChunk )
+            : chunkRows( rowsPerChunk ) {
+            requireLittleEndian();
+            for ( std::size_t i = 0; i < names.size(); ++i ) {
+                auto it = std::find_if( input.columns.begin(), input.columns.end(),
+                                        [ & ]( const auto& column ) { return column.first == names[ i ]; } );
+                if ( it == input.columns.end() )
+                    throw std::runtime_error( "Unknown column: " + names[ i ] );
+                files.emplace_back( it->second );
+                if ( files.back().size() % sizeof( double ) != 0 )
+                    throw std::runtime_error( "Column file size is not a multiple of 8 bytes: " + it->second );
+                std::size_t rows = files.back().size() / sizeof( double );
+                if ( i > 0 && rows != total )
+                    throw std::runtime_error( "Column files have different lengths: " + it->second );
+                total = rows;
+            }
+        }
+
+        std::size_t prepare( Chunk& chunk ) override {
+            chunk.columns.resize( files.size() );
+            return 0;
+        }
+
+        std::size_t fill( Chunk& chunk ) override {
+            // 没有任何输入列时表达式是常量，没有行可以求值
+            std::size_t rows = files.empty() ? 0 : std::min( chunkRows, total - cursor );
+            for ( std::size_t i = 0; i < files.size(); ++i ) {
+                chunk.columns[ i ] = Column{ reinterpret_cast< const double* >( files[ i ].data() ) + cursor };
+                files[ i ].prefetch( ( cursor + rows ) * sizeof( double ), chunkRows * sizeof( double ) );
+            }
+            chunk.first = cursor;
+            cursor += rows;
+            return rows;
+        }
+
+        void consumed( const Chunk& chunk ) override {
+            for ( const MappedFile& file : files )
+                file.discard( chunk.first * sizeof( double ), chunk.rows * sizeof( double ) );
+        }
+    };
+
+    // 双缓冲流水线：后台线程把下一块读进另一组缓冲区，当前块在线程池上求值并写出
+    StreamStats run( const Compiled& compiled, ChunkSource& source, const std::string& outputPath,
+                     const StreamOptions& options ) {
+        if ( options.chunkRows == 0 )
+            throw std::invalid_argument( "chunkRows must be positive" );
+        if ( options.output == OutputFormat::BINARY )
+            requireLittleEndian();
+        std::ofstream out( outputPath, std::ios::binary | std::ios::trunc );
+        if ( !out )
+            throw std::runtime_error( "Cannot open output file: " + outputPath );
+
+        StreamStats stats;
+        Chunk chunks[ 2 ];
+        for ( Chunk& chunk : chunks )
+            stats.bufferBytes += source.prepare( chunk );
+        AlignedBuffer results = allocate( options.chunkRows );
+        std::vector< EvalStatus > status( options.chunkRows );
+        std::string text;
+        if ( options.output == OutputFormat::TEXT )
+            text.reserve( options.chunkRows * 25 );
+        stats.bufferBytes += options.chunkRows * ( sizeof( double ) + sizeof( EvalStatus ) ) + text.capacity();
+
+        std::mutex mutex;
+        std::condition_variable changed;
+        bool ready[ 2 ] = { false, false };
+        bool stopping   = false;
+        std::exception_ptr error;
+
+        std::thread producer( [ & ] {
+            try {
+                for ( std::size_t i = 0;; ++i ) {
+                    Chunk& chunk = chunks[ i % 2 ];
+                    {
+                        std::unique_lock lock( mutex );
+                        changed.wait( lock, [ & ] { return stopping || !ready[ i % 2 ]; } );
+                        if ( stopping )
+                            return;
+                    }
+                    chunk.rows = source.fill( chunk );
+                    {
+                        std::scoped_lock lock( mutex );
+                        ready[ i % 2 ] = true;
+                    }
+                    changed.notify_all();
+                    if ( chunk.rows == 0 )
+                        return;
+                }
+            }
+            catch ( ... ) {
+                {
+                    std::scoped_lock lock( mutex );
+                    error = std::current_exception();
+                }
+                changed.notify_all();
+            }
+        } );
+        auto stopProducer = [ & ] {
+            {
+                std::scoped_lock lock( mutex );
+                stopping = true;
+            }
+            changed.notify_all();
+            producer.join();
+        };
+
+        try {
+            for ( std::size_t i = 0;; ++i ) {
+                Chunk& chunk = chunks[ i % 2 ];
+                {
+                    std::unique_lock lock( mutex );
+                    changed.wait( lock, [ & ] { return error || ready[ i % 2 ]; } );
+                    if ( error )
+                        break;
+                }
+                if ( chunk.rows == 0 )
+                    break;
+
+                BatchEvaluator evaluator( compiled.program, chunk.columns );
+                sharedThreadPool().parallelFor(
+                    chunk.rows,
+                    [ & ]( std::size_t begin, std::size_t end ) {
+                        evaluator.run( begin, end - begin, results.get() + begin, status.data() + begin );
+                    },
+                    EVALUATE_GRAIN );
+                stats.errors += static_cast< std::size_t >(
+                    std::count_if( status.begin(), status.begin() + static_cast< std::ptrdiff_t >( chunk.rows ),
+                                   []( EvalStatus s ) { return s != EvalStatus::OK; } ) );
+
+                if ( options.output == OutputFormat::BINARY ) {
+                    out.write( reinterpret_cast< const char* >( results.get() ),
+                               static_cast< std::streamsize >( chunk.rows * sizeof( double ) ) );
+                }
+                else {
+                    text.clear();
+                    char number[ 32 ];
+                    for ( std::size_t row = 0; row < chunk.rows; ++row ) {
+                        auto [ end, ec ] = std::to_chars( number, number + sizeof( number ), results[ row ] );
+                        static_cast< void >( ec );
+                        text.append( number, end );
+                        text.push_back( '\n' );
+                    }
+                    out.write( text.data(), static_cast< std::streamsize >( text.size() ) );
+                }
+                if ( !out )
+                    throw std::runtime_error( "Cannot write output file: " + outputPath );
+
+                source.consumed( chunk );
+                stats.rows += chunk.rows;
+                ++stats.chunks;
+                {
+                    std::scoped_lock lock( mutex );
+                    ready[ i % 2 ] = false;
+                }
+                changed.notify_all();
+            }
+        }
+        catch ( ... ) {
+            stopProducer();
+            throw;
+        }
+        stopProducer();
+        if ( error )
+            std::rethrow_exception( error );
+        out.flush();
+        if ( !out )
+            throw std::runtime_error( "Cannot write output file: " + outputPath );
+        return stats;
+    }
+}  // namespace
+
+StreamStats evaluateCsv( const std::string& expression, const CsvInput& input, const std::string& outputPath,
+                         const StreamOptions& options ) {
+    Compiled compiled = compile( expression );
+    CsvSource source( input, compiled.program.columns, options.chunkRows );
+    return run( compiled, source, outputPath, options );
+}
+
+StreamStats evaluateColumnFiles( const std::string& expression, const ColumnFilesInput& input,
+                                 const std::string& outputPath, const StreamOptions& options ) {
+    Compiled compiled = compile( expression );
+    ColumnFilesSource source( input, compiled.program.columns, options.chunkRows );
+    return run( compiled, source, outputPath, options );
+}
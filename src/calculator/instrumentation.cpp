@@ -0,0 +1,252 @@
+#include <atomic>
+#include <format>
+#include <mutex>
+#include <ostream>
+#include <simple_calculator/instrumentation.hpp>
+#include <spdlog/spdlog.h>
+#include <vector>
+
+namespace instrumentation {
+
+    namespace {
+        using Clock = std::chrono::steady_clock;
+
+        // trace 事件数量上限，超出后只累计统计不再记录事件
+        constexpr std::size_t MAX_TRACE_EVENTS = 1 << 20;
+
+        struct AtomicPhase {
+            std::atomic< std::uint64_t > calls{ 0 };
+            std::atomic< std::uint64_t > nanoseconds{ 0 };
+        };
+
+        struct AtomicNode {
+            std::atomic< std::uint64_t > evaluations{ 0 };
+            std::atomic< std::uint64_t > totalNanoseconds{ 0 };
+            std::atomic< std::uint64_t > selfNanoseconds{ 0 };
+        };
+
+        struct TraceEvent {
+            Phase phase;
+            std::uint32_t thread;
+            std::uint64_t startNanoseconds;
+            std::uint64_t durationNanoseconds;
+        };
+
+        struct State {
+            std::array< AtomicPhase, static_cast< std::size_t >( Phase::COUNT ) > phases;
+            std::array< AtomicNode, static_cast< std::size_t >( NodeKind::COUNT ) > nodes;
+            std::atomic< std::uint64_t > tokens{ 0 };
+            std::atomic< std::uint64_t > nodesBuilt{ 0 };
+            std::atomic< std::uint64_t > allocations{ 0 };
+            std::atomic< std::uint32_t > nextThread{ 0 };
+            Clock::time_point epoch = Clock::now();
+            std::mutex traceMutex;
+            std::vector< TraceEvent > trace;
+        };
+
+        State& state() {
+            static State instance;
+            return instance;
+        }
+
+        std::uint32_t threadIndex() {
+            thread_local std::uint32_t index = state().nextThread++;
+            return index;
+        }
+
+        std::uint64_t nanoseconds( Clock::duration d ) {
+            return static_cast< std::uint64_t >( std::chrono::duration_cast< std::chrono::nanoseconds >( d ).count() );
+        }
+
+        void recordPhase( Phase phase, Clock::time_point start, Clock::time_point end, bool traced ) {
+            State& s      = state();
+            auto& stats   = s.phases[ static_cast< std::size_t >( phase ) ];
+            auto duration = nanoseconds( end - start );
+            stats.calls.fetch_add( 1, std::memory_order_relaxed );
+            stats.nanoseconds.fetch_add( duration, std::memory_order_relaxed );
+            if ( !traced )
+                return;
+            std::scoped_lock lock( s.traceMutex );
+            if ( s.trace.size() < MAX_TRACE_EVENTS )
+                s.trace.push_back( TraceEvent{ phase, threadIndex(), nanoseconds( start - s.epoch ), duration } );
+        }
+
+        thread_local NodeScope* currentNode = nullptr;
+    }  // namespace
+
+    const char* phaseName( Phase phase ) {
+        switch ( phase ) {
+        case Phase::LEX:
+            return "lex";
+        case Phase::PARSE:
+            return "parse";
+        case Phase::EVALUATE:
+            return "evaluate";
+        case Phase::BATCH:
+            return "batch";
+        case Phase::COUNT:
+            break;
+        }
+        return "unknown";
+    }
+
+    const char* nodeKindName( NodeKind kind ) {
+        // clang-format off
+        static constexpr std::array< const char*, static_cast< std::size_t >( NodeKind::COUNT ) > names{
+            "NumberNode", "VariableNode", "SlotNode", "ArrayVariableNode",
+            "AddNode", "SubtractNode", "MultiplyNode", "DivideNode", "PowerNode", "ModuloNode",
+            "SqrtNode", "SinNode", "CosNode", "TanNode", "LgNode", "LnNode", "FactorialNode",
+            "SumNode", "MeanNode", "MinNode", "MaxNode", "DotNode",
+            "LessNode", "LessEqualNode", "GreaterNode", "GreaterEqualNode", "EqualNode", "NotEqualNode",
+            "MinimumNode", "MaximumNode", "AbsNode", "IfNode",
+        };
+        // clang-format on
+        auto index = static_cast< std::size_t >( kind );
+        return index < names.size() ? names[ index ] : "unknown";
+    }
+
+    void reset() {
+        State& s = state();
+        for ( auto& phase : s.phases ) {
+            phase.calls       = 0;
+            phase.nanoseconds = 0;
+        }
+        for ( auto& node : s.nodes ) {
+            node.evaluations      = 0;
+            node.totalNanoseconds = 0;
+            node.selfNanoseconds  = 0;
+        }
+        s.tokens      = 0;
+        s.nodesBuilt  = 0;
+        s.allocations = 0;
+        std::scoped_lock lock( s.traceMutex );
+        s.trace.clear();
+        s.epoch = Clock::now();
+    }
+
+    Snapshot snapshot() {
+        State& s = state();
+        Snapshot result;
+        for ( std::size_t i = 0; i < result.phases.size(); ++i ) {
+            result.phases[ i ].calls       = s.phases[ i ].calls.load( std::memory_order_relaxed );
+            result.phases[ i ].nanoseconds = s.phases[ i ].nanoseconds.load( std::memory_order_relaxed );
+        }
+        for ( std::size_t i = 0; i < result.nodes.size(); ++i ) {
+            result.nodes[ i ].evaluations      = s.nodes[ i ].evaluations.load( std::memory_order_relaxed );
+            result.nodes[ i ].totalNanoseconds = s.nodes[ i ].totalNanoseconds.load( std::memory_order_relaxed );
+            result.nodes[ i ].selfNanoseconds  = s.nodes[ i ].selfNanoseconds.load( std::memory_order_relaxed );
+        }
+        result.tokens      = s.tokens.load( std::memory_order_relaxed );
+        result.nodesBuilt  = s.nodesBuilt.load( std::memory_order_relaxed );
+        result.allocations = s.allocations.load( std::memory_order_relaxed );
+        return result;
+    }
+
+    void writeChromeTrace( std::ostream& out ) {
+        State& s = state();
+        std::vector< TraceEvent > events;
+        {
+            std::scoped_lock lock( s.traceMutex );
+            events = s.trace;
+        }
+        // ts/dur 的单位是微秒
+        out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+        bool first = true;
+        for ( const auto& event : events ) {
+            out << ( first ? "" : "," )
+                << std::format( "{{\"name\":\"{}\",\"cat\":\"calculator\",\"ph\":\"X\",\"pid\":1,\"tid\":{},"
+                                "\"ts\":{:.3f},\"dur\":{:.3f}}}",
+                                phaseName( event.phase ), event.thread,
+                                static_cast< double >( event.startNanoseconds ) / 1000.0,
+                                static_cast< double >( event.durationNanoseconds ) / 1000.0 );
+            first = false;
+        }
+        // 计数器与按节点类型的统计作为元数据写入
+        Snapshot stats = snapshot();
+        out << ( first ? "" : "," )
+            << std::format( "{{\"name\":\"counters\",\"ph\":\"C\",\"pid\":1,\"tid\":0,\"ts\":0,"
+                            "\"args\":{{\"tokens\":{},\"nodes\":{},\"allocations\":{}}}}}",
+                            stats.tokens, stats.nodesBuilt, stats.allocations );
+        out << "],\"otherData\":{";
+        first = true;
+        for ( std::size_t i = 0; i < stats.nodes.size(); ++i ) {
+            const NodeStats& node = stats.nodes[ i ];
+            if ( node.evaluations == 0 )
+                continue;
+            out << ( first ? "" : "," )
+                << std::format( "\"{}\":{{\"evaluations\":{},\"total_ns\":{},\"self_ns\":{}}}",
+                                nodeKindName( static_cast< NodeKind >( i ) ), node.evaluations,
+                                node.totalNanoseconds, node.selfNanoseconds );
+            first = false;
+        }
+        out << "}}";
+    }
+
+    std::string summary() {
+        Snapshot stats = snapshot();
+        std::string text =
+            std::format( "tokens={} nodes={} allocations={}", stats.tokens, stats.nodesBuilt, stats.allocations );
+        for ( std::size_t i = 0; i < stats.phases.size(); ++i ) {
+            const PhaseStats& phase = stats.phases[ i ];
+            text += std::format( "\n  {:<8} calls={:<10} time={:.3f}ms", phaseName( static_cast< Phase >( i ) ),
+                                 phase.calls, static_cast< double >( phase.nanoseconds ) / 1e6 );
+        }
+        for ( std::size_t i = 0; i < stats.nodes.size(); ++i ) {
+            const NodeStats& node = stats.nodes[ i ];
+            if ( node.evaluations == 0 )
+                continue;
+            text += std::format( "\n  {:<18} evaluations={:<10} total={:.3f}ms self={:.3f}ms",
+                                 nodeKindName( static_cast< NodeKind >( i ) ), node.evaluations,
+                                 static_cast< double >( node.totalNanoseconds ) / 1e6,
+                                 static_cast< double >( node.selfNanoseconds ) / 1e6 );
+        }
+        return text;
+    }
+
+    void logSummary() {
+        if constexpr ( !enabled() )
+            spdlog::info( "calculator instrumentation is disabled at compile time" );
+        else
+            spdlog::info( "calculator instrumentation:\n{}", summary() );
+    }
+
+    void countToken() {
+        state().tokens.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    void countNode() {
+        // 每个节点都是一次独立的堆分配
+        state().nodesBuilt.fetch_add( 1, std::memory_order_relaxed );
+        state().allocations.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    void countAllocation() {
+        state().allocations.fetch_add( 1, std::memory_order_relaxed );
+    }
+
+    PhaseScope::PhaseScope( Phase p, bool trace ) : phase( p ), start( Clock::now() ), traced( trace ) {}
+
+    PhaseScope::~PhaseScope() {
+        recordPhase( phase, start, Clock::now(), traced );
+    }
+
+    NodeScope::NodeScope( NodeKind k ) : kind( k ), start( Clock::now() ), parent( currentNode ) {
+        currentNode = this;
+    }
+
+    NodeScope::~NodeScope() {
+        auto end      = Clock::now();
+        auto total    = nanoseconds( end - start );
+        auto& stats   = state().nodes[ static_cast< std::size_t >( kind ) ];
+        stats.evaluations.fetch_add( 1, std::memory_order_relaxed );
+        stats.totalNanoseconds.fetch_add( total, std::memory_order_relaxed );
+        stats.selfNanoseconds.fetch_add( total > childNanoseconds ? total - childNanoseconds : 0,
+                                         std::memory_order_relaxed );
+        currentNode = parent;
+        if ( parent )
+            parent->childNanoseconds += total;
+        else
+            recordPhase( Phase::EVALUATE, start, end, true );
+    }
+
+}  // namespace instrumentation
@@ -0,0 +1,120 @@
+#include <simple_calculator/mapped_file.hpp>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile( const std::string& path ) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA( path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                               FILE_ATTRIBUTE_NORMAL, nullptr );
+    if ( file == INVALID_HANDLE_VALUE )
+        throw std::runtime_error( "Cannot open file: " + path );
+    LARGE_INTEGER size{};
+    GetFileSizeEx( file, &size );
+    if ( size.QuadPart == 0 ) {
+        CloseHandle( file );
+        return;
+    }
+    HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+    CloseHandle( file );
+    void* view = mapping ? MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) : nullptr;
+    if ( mapping )
+        CloseHandle( mapping );
+    if ( !view )
+        throw std::runtime_error( "Cannot map file: " + path );
+    bytes  = static_cast< const std::byte* >( view );
+    length = static_cast< std::size_t >( size.QuadPart );
+#else
+    int fd = ::open( path.c_str(), O_RDONLY | O_CLOEXEC );
+    if ( fd < 0 )
+        throw std::runtime_error( "Cannot open file: " + path );
+    struct stat info{};
+    if ( fstat( fd, &info ) != 0 ) {
+        ::close( fd );
+        throw std::runtime_error( "Cannot open file: " + path );
+    }
+    if ( info.st_size == 0 ) {
+        ::close( fd );
+        return;
+    }
+    auto size  = static_cast< std::size_t >( info.st_size );
+    void* view = mmap( nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    ::close( fd );
+    if ( view == MAP_FAILED )
+        throw std::runtime_error( "Cannot map file: " + path );
+    bytes  = static_cast< const std::byte* >( view );
+    length = size;
+#endif
+}
+
+void MappedFile::release() {
+    if ( bytes ) {
+#ifdef _WIN32
+        UnmapViewOfFile( bytes );
+#else
+        munmap( const_cast< std::byte* >( bytes ), length );
+#endif
+    }
+    bytes  = nullptr;
+    length = 0;
+}
+
+MappedFile::~MappedFile() {
+    release();
+}
+
+MappedFile::MappedFile( MappedFile&& other ) noexcept
+    : bytes( std::exchange( other.bytes, nullptr ) ), length( std::exchange( other.length, 0 ) ) {}
+
+MappedFile& MappedFile::operator=( MappedFile&& other ) noexcept {
+    if ( this != &other ) {
+        release();
+        bytes  = std::exchange( other.bytes, nullptr );
+        length = std::exchange( other.length, 0 );
+    }
+    return *this;
+}
+
+#ifdef _WIN32
+// Windows 上没有与 madvise 对应且对只读映射安全的接口，两者都只是提示，忽略即可
+void MappedFile::prefetch( std::size_t, std::size_t ) const {}
+void MappedFile::discard( std::size_t, std::size_t ) const {}
+#else
+namespace {
+    std::size_t pageSize() {
+        static const auto size = static_cast< std::size_t >( sysconf( _SC_PAGESIZE ) );
+        return size;
+    }
+}  // namespace
+
+void MappedFile::prefetch( std::size_t offset, std::size_t size ) const {
+    if ( offset >= length )
+        return;
+    size              = std::min( size, length - offset );
+    std::size_t begin = offset / pageSize() * pageSize();
+    madvise( const_cast< std::byte* >( bytes ) + begin, offset + size - begin, MADV_WILLNEED );
+}
+
+void MappedFile::discard( std::size_t offset, std::size_t size ) const {
+    if ( offset >= length )
+        return;
+    size              = std::min( size, length - offset );
+    std::size_t page  = pageSize();
+    std::size_t begin = offset / page * page;
+    std::size_t end   = offset + size == length ? length : ( offset + size ) / page * page;
+    // 只读的私有映射没有被改写过的页面，丢弃后再访问会从文件重新读入
+    if ( end > begin )
+        madvise( const_cast< std::byte* >( bytes ) + begin, end - begin, MADV_DONTNEED );
+}
+#endif
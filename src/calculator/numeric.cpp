@@ -0,0 +1,245 @@
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <simple_calculator/numeric.hpp>
+#include <stdexcept>
+#include <vector>
+
+UnivariateFunction::UnivariateFunction( const std::string& expression, const std::string& variable,
+                                        const Parser::Resolver& fallback ) {
+    Lexer lexer( expression );
+    Parser parser( lexer, [ this, &variable, &fallback ]( const std::string& name ) -> std::unique_ptr< ASTNode > {
+        if ( name == variable )
+            return std::make_unique< VariableNode >( name, &scalar );
+        return fallback ? fallback( name ) : nullptr;
+    } );
+    ast     = parser.parse();
+    program = compileBatch( *ast, { variable } );
+}
+
+void UnivariateFunction::evaluate( std::span< const double > xs, std::span< double > out, EvalStatus* status ) {
+    if ( out.size() < xs.size() )
+        throw std::invalid_argument( "Output buffer is smaller than the input" );
+    Column column{ xs.data() };
+    BatchEvaluator evaluator( program, std::span( &column, 1 ) );
+    evaluator.run( 0, xs.size(), out.data(), status );
+    count += xs.size();
+}
+
+double UnivariateFunction::operator()( double x ) {
+    double result = 0;
+    evaluate( std::span( &x, 1 ), std::span( &result, 1 ) );
+    return result;
+}
+
+SolveResult solve( UnivariateFunction& f, std::pair< double, double > bracket, double tolerance,
+                   std::size_t maxIterations ) {
+    std::size_t start = f.evaluations();
+    SolveResult result;
+
+    std::array< double, 2 > ends{ bracket.first, bracket.second };
+    std::array< double, 2 > values{};
+    f.evaluate( ends, values );
+    double a = ends[ 0 ], b = ends[ 1 ];
+    double fa = values[ 0 ], fb = values[ 1 ];
+    if ( ( fa > 0 && fb > 0 ) || ( fa < 0 && fb < 0 ) )
+        throw std::runtime_error( "Root is not bracketed" );
+
+    double c = b, fc = fb;
+    double d = b - a, e = d;
+    for ( std::size_t iteration = 1; iteration <= maxIterations; ++iteration ) {
+        if ( ( fb > 0 && fc > 0 ) || ( fb < 0 && fc < 0 ) ) {
+            c  = a;
+            fc = fa;
+            d = e = b - a;
+        }
+        if ( std::abs( fc ) < std::abs( fb ) ) {
+            a  = b;
+            b  = c;
+            c  = a;
+            fa = fb;
+            fb = fc;
+            fc = fa;
+        }
+        double tol1 = 2 * std::numeric_limits< double >::epsilon() * std::abs( b ) + 0.5 * tolerance;
+        double xm   = 0.5 * ( c - b );
+        result.iterations = iteration;
+        if ( std::abs( xm ) <= tol1 || fb == 0 ) {
+            result.converged = true;
+            break;
+        }
+        if ( std::abs( e ) >= tol1 && std::abs( fa ) > std::abs( fb ) ) {
+            // 反二次插值或割线法
+            double s = fb / fa;
+            double p = 0, q = 0;
+            if ( a == c ) {
+                p = 2 * xm * s;
+                q = 1 - s;
+            }
+            else {
+                double qa = fa / fc;
+                double r  = fb / fc;
+                p         = s * ( 2 * xm * qa * ( qa - r ) - ( b - a ) * ( r - 1 ) );
+                q         = ( qa - 1 ) * ( r - 1 ) * ( s - 1 );
+            }
+            if ( p > 0 )
+                q = -q;
+            p = std::abs( p );
+            if ( 2 * p < std::min( 3 * xm * q - std::abs( tol1 * q ), std::abs( e * q ) ) ) {
+                e = d;
+                d = p / q;
+            }
+            else {
+                d = xm;
+                e = d;
+            }
+        }
+        else {
+            // 二分
+            d = xm;
+            e = d;
+        }
+        a  = b;
+        fa = fb;
+        b += std::abs( d ) > tol1 ? d : std::copysign( tol1, xm );
+        fb = f( b );
+    }
+
+    result.root        = b;
+    result.residual    = fb;
+    result.evaluations = f.evaluations() - start;
+    return result;
+}
+
+SolveResult solve( const std::string& expression, const std::string& variable, std::pair< double, double > bracket,
+                   double tolerance ) {
+    UnivariateFunction f( expression, variable );
+    return solve( f, bracket, tolerance );
+}
+
+namespace {
+    // QUADPACK qk15 的节点与权重
+    constexpr std::array< double, 8 > KRONROD_NODES{
+        0.991455371120812639206854697526329, 0.949107912342758524526189684047851, 0.864864423359769072789712788640926,
+        0.741531185599394439863864773280788, 0.586087235467691130294144845693013, 0.405845151377397166906606412076961,
+        0.207784955007898467600689403773245, 0.000000000000000000000000000000000,
+    };
+    constexpr std::array< double, 8 > KRONROD_WEIGHTS{
+        0.022935322010529224963732008058970, 0.063092092629978553290700663189204, 0.104790010322250183839876322541518,
+        0.140653259715525918745189590510238, 0.169004726639267902826583426598550, 0.190350578064785409913256402421014,
+        0.204432940075298892414161999234649, 0.209482141084727828012999174891714,
+    };
+    // 7 点 Gauss 权重，对应 KRONROD_NODES 中下标为奇数的节点
+    constexpr std::array< double, 4 > GAUSS_WEIGHTS{
+        0.129484966168869693270611432679082,
+        0.279705391489276667901467771423780,
+        0.381830050505118944950369775488975,
+        0.417959183673469387755102040816327,
+    };
+    constexpr std::size_t POINTS = 15;
+
+    struct Interval {
+        double a, b;
+        double value = 0, error = 0;
+    };
+
+    // 一次批量求值所有区间的 15 个节点，然后计算每个区间的 K15 值和 |K15 - G7| 误差估计
+    void evaluateIntervals( UnivariateFunction& f, std::span< Interval > intervals, std::vector< double >& xs,
+                            std::vector< double >& ys ) {
+        xs.resize( intervals.size() * POINTS );
+        ys.resize( xs.size() );
+        for ( std::size_t k = 0; k < intervals.size(); ++k ) {
+            double center = 0.5 * ( intervals[ k ].a + intervals[ k ].b );
+            double half   = 0.5 * ( intervals[ k ].b - intervals[ k ].a );
+            double* x     = xs.data() + k * POINTS;
+            for ( std::size_t j = 0; j < 7; ++j ) {
+                x[ 2 * j ]     = center - half * KRONROD_NODES[ j ];
+                x[ 2 * j + 1 ] = center + half * KRONROD_NODES[ j ];
+            }
+            x[ 14 ] = center;
+        }
+        f.evaluate( xs, ys );
+        for ( std::size_t k = 0; k < intervals.size(); ++k ) {
+            const double* y = ys.data() + k * POINTS;
+            double half     = 0.5 * ( intervals[ k ].b - intervals[ k ].a );
+            double kronrod  = KRONROD_WEIGHTS[ 7 ] * y[ 14 ];
+            double gauss    = GAUSS_WEIGHTS[ 3 ] * y[ 14 ];
+            for ( std::size_t j = 0; j < 7; ++j ) {
+                double pair = y[ 2 * j ] + y[ 2 * j + 1 ];
+                kronrod += KRONROD_WEIGHTS[ j ] * pair;
+                if ( j % 2 == 1 )
+                    gauss += GAUSS_WEIGHTS[ j / 2 ] * pair;
+            }
+            intervals[ k ].value = kronrod * half;
+            intervals[ k ].error = std::abs( ( kronrod - gauss ) * half );
+        }
+    }
+}  // namespace
+
+IntegrateResult integrate( UnivariateFunction& f, double a, double b, double tolerance, std::size_t maxIntervals ) {
+    std::size_t start = f.evaluations();
+    IntegrateResult result;
+    std::vector< double > xs, ys;
+
+    std::vector< Interval > done;
+    std::vector< Interval > active{ Interval{ a, b } };
+    evaluateIntervals( f, active, xs, ys );
+
+    double length = std::abs( b - a );
+    for ( ;; ) {
+        double value = 0, error = 0;
+        for ( const auto& interval : done ) {
+            value += interval.value;
+            error += interval.error;
+        }
+        for ( const auto& interval : active ) {
+            value += interval.value;
+            error += interval.error;
+        }
+        result.value         = value;
+        result.errorEstimate = error;
+        if ( error <= tolerance ) {
+            result.converged = true;
+            break;
+        }
+        if ( length == 0 )
+            break;
+
+        // 误差超过其长度所占容差份额的区间一分为二，其余区间冻结；
+        // 若没有区间超额(舍入导致)，则只细分误差最大的那个
+        std::vector< Interval > refine;
+        std::vector< Interval > kept;
+        auto largest = std::max_element( active.begin(), active.end(),
+                                         []( const Interval& l, const Interval& r ) { return l.error < r.error; } );
+        for ( auto it = active.begin(); it != active.end(); ++it ) {
+            double share = tolerance * std::abs( it->b - it->a ) / length;
+            if ( it->error > share || it == largest ) {
+                double mid = 0.5 * ( it->a + it->b );
+                refine.push_back( Interval{ it->a, mid } );
+                refine.push_back( Interval{ mid, it->b } );
+                kept.push_back( *it );
+            }
+            else {
+                done.push_back( *it );
+            }
+        }
+        // 细分会超出区间上限时放弃，结果保留本轮开始时的估计
+        if ( done.size() + refine.size() > maxIntervals ) {
+            active = std::move( kept );
+            break;
+        }
+        evaluateIntervals( f, refine, xs, ys );
+        active = std::move( refine );
+    }
+
+    result.intervals   = done.size() + active.size();
+    result.evaluations = f.evaluations() - start;
+    return result;
+}
+
+IntegrateResult integrate( const std::string& expression, const std::string& variable, double a, double b,
+                           double tolerance ) {
+    UnivariateFunction f( expression, variable );
+    return integrate( f, a, b, tolerance );
+}
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <limits>
+#include <simple_calculator/budget.hpp>
+#include <simple_calculator/calculator.hpp>
+#include <simple_calculator/parallel.hpp>
+#include <stdexcept>
+
+namespace {
+    bool sumLink( ChainLink link ) {
+        return link == ChainLink::ADD || link == ChainLink::SUBTRACT;
+    }
+
+    // 同一优先级(同一个解析循环)产生的运算才能连成一条链
+    bool sameChain( ChainLink a, ChainLink b ) {
+        return a != ChainLink::NONE && b != ChainLink::NONE && sumLink( a ) == sumLink( b );
+    }
+
+    std::uint32_t checkedIndex( std::size_t index ) {
+        if ( index > std::numeric_limits< std::uint32_t >::max() )
+            throw std::runtime_error( "Expression too large for parallel evaluation" );
+        return static_cast< std::uint32_t >( index );
+    }
+
+    // 在线程池上同时执行 a 和 b，工作线程沿用调用线程的时限
+    template < typename A, typename B >
+    void fork( ThreadPool& pool, A&& a, B&& b ) {
+        auto deadline = currentDeadline();
+        pool.parallelFor( 2, [ & ]( std::size_t begin, std::size_t end ) {
+            DeadlineScope scope( deadline );
+            for ( std::size_t i = begin; i < end; ++i ) {
+                if ( i == 0 )
+                    a();
+                else
+                    b();
+            }
+        } );
+    }
+}  // namespace
+
+ParallelEvaluator::ParallelEvaluator( const ASTNode& root, const ParallelOptions& opts ) : options( opts ) {
+    if ( !options.pool )
+        options.pool = &sharedThreadPool();
+    build( root );
+    values.resize( plan.size() );
+}
+
+void ParallelEvaluator::build( const ASTNode& root ) {
+    struct Operand {
+        const ASTNode* ast;
+        const BinaryOpNode* op;
+        bool negate;
+    };
+    // 正在展开的节点，它的操作数位于 operands[operandBegin, operandBegin + operandCount)
+    struct Frame {
+        Kind kind;
+        Merge merge;
+        const ASTNode* node;
+        std::uint32_t first;
+        std::size_t operandBegin;
+        std::size_t operandCount;
+        std::size_t next;
+    };
+    std::vector< Operand > operands;
+    std::vector< Frame > frames;
+    std::vector< std::uint32_t > done;  // 已完成的子树在 plan 中的下标
+    std::vector< Operand > spine;
+    ParallelPlanner planner;
+
+    auto expand = [ & ]( const ASTNode& ast ) {
+        ast.plan( planner );
+        const ParallelPlanner::Shape shape = planner.shape();
+        Frame frame{ Kind::LEAF, Merge::ORDERED, shape.node, checkedIndex( plan.size() ), operands.size(), 0, 0 };
+        switch ( shape.kind ) {
+        case ParallelPlanner::Kind::LEAF:
+            break;
+        case ParallelPlanner::Kind::UNARY:
+            frame.kind = Kind::UNARY;
+            operands.push_back( Operand{ shape.children[ 0 ], nullptr, false } );
+            break;
+        case ParallelPlanner::Kind::BINARY:
+            if ( shape.link == ChainLink::NONE ) {
+                frame.kind = Kind::BINARY;
+                operands.push_back( Operand{ shape.children[ 0 ], nullptr, false } );
+                operands.push_back( Operand{ shape.children[ 1 ], nullptr, false } );
+                break;
+            }
+            // 沿左侧边收集同一优先级的整条链：a + b - c 的各项依次为 a、+b、-c
+            frame.kind        = Kind::CHAIN;
+            bool reassociable = options.reassociation == Reassociation::BALANCED;
+            spine.clear();
+            for ( ParallelPlanner::Shape link = shape;; ) {
+                reassociable = reassociable && link.link != ChainLink::ORDERED;
+                spine.push_back( Operand{ link.children[ 1 ], static_cast< const BinaryOpNode* >( link.node ),
+                                          link.link == ChainLink::SUBTRACT } );
+                const ASTNode* next = link.children[ 0 ];
+                next->plan( planner );
+                link = planner.shape();
+                if ( link.kind != ParallelPlanner::Kind::BINARY || !sameChain( link.link, shape.link ) ) {
+                    spine.push_back( Operand{ next, nullptr, false } );
+                    break;
+                }
+            }
+            operands.insert( operands.end(), spine.rbegin(), spine.rend() );
+            frame.merge = !reassociable ? Merge::ORDERED : sumLink( shape.link ) ? Merge::SUM : Merge::PRODUCT;
+            break;
+        }
+        frame.operandCount = operands.size() - frame.operandBegin;
+        frames.push_back( frame );
+    };
+
+    expand( root );
+    while ( !frames.empty() ) {
+        Frame& frame = frames.back();
+        if ( frame.next < frame.operandCount ) {
+            const ASTNode* child = operands[ frame.operandBegin + frame.next++ ].ast;
+            expand( *child );
+            continue;
+        }
+
+        Node node{ frame.kind, frame.merge, frame.node, frame.first, checkedIndex( terms.size() ),
+                   checkedIndex( frame.operandCount ), 0 };
+        std::size_t children = done.size() - frame.operandCount;
+        double prefix        = 0;
+        for ( std::size_t k = 0; k < frame.operandCount; ++k ) {
+            const Operand& operand = operands[ frame.operandBegin + k ];
+            std::uint32_t child    = done[ children + k ];
+            prefix += plan[ child ].cost;
+            terms.push_back( Term{ child, operand.op, operand.negate, prefix } );
+        }
+        node.cost = prefix + ( node.kind == Kind::LEAF ? estimateCost( *node.node ).cost
+                                                       : cost_weight::ARITHMETIC *
+                                                             static_cast< double >( std::max< std::size_t >(
+                                                                 frame.operandCount - 1, 1 ) ) );
+        if ( node.kind == Kind::CHAIN ) {
+            ++chainCount;
+            longest = std::max< std::size_t >( longest, frame.operandCount );
+        }
+
+        done.resize( children );
+        operands.resize( frame.operandBegin );
+        frames.pop_back();
+        done.push_back( checkedIndex( plan.size() ) );
+        plan.push_back( node );
+    }
+}
+
+double ParallelEvaluator::compute( const Node& node ) const {
+    const Term* operand = terms.data() + node.termBegin;
+    switch ( node.kind ) {
+    case Kind::LEAF:
+        return node.node->evaluate();
+    case Kind::UNARY:
+        return static_cast< const UnaryFunctionNode* >( node.node )->apply( values[ operand[ 0 ].child ] );
+    case Kind::BINARY:
+        return static_cast< const BinaryOpNode* >( node.node )
+            ->apply( values[ operand[ 0 ].child ], values[ operand[ 1 ].child ] );
+    case Kind::CHAIN:
+        return combine( node );
+    }
+    return 0;
+}
+
+double ParallelEvaluator::combine( const Node& node ) const {
+    if ( node.merge != Merge::ORDERED )
+        return pairwise( node, 0, node.termCount );
+    const Term* term = terms.data() + node.termBegin;
+    double result    = values[ term[ 0 ].child ];
+    for ( std::uint32_t k = 1; k < node.termCount; ++k )
+        result = term[ k ].op->apply( result, values[ term[ k ].child ] );
+    return result;
+}
+
+// 固定的平衡合并顺序：每次从中间分开。并行的 reduce() 按同样的位置拆分，所以结果与线程数无关
+double ParallelEvaluator::pairwise( const Node& node, std::uint32_t lo, std::uint32_t hi ) const {
+    if ( hi - lo == 1 ) {
+        const Term& term = terms[ node.termBegin + lo ];
+        double value     = values[ term.child ];
+        return term.negate ? -value : value;
+    }
+    std::uint32_t mid = lo + ( hi - lo ) / 2;
+    double a          = pairwise( node, lo, mid );
+    double b          = pairwise( node, mid, hi );
+    return node.merge == Merge::SUM ? a + b : a * b;
+}
+
+double ParallelEvaluator::termCost( const Node& node, std::uint32_t lo, std::uint32_t hi ) const {
+    const Term* term = terms.data() + node.termBegin;
+    return term[ hi - 1 ].prefixCost - ( lo > 0 ? term[ lo - 1 ].prefixCost : 0 );
+}
+
+// 后序排列保证子节点总在父节点之前，顺序循环即可求出 [first, last] 中的整棵子树
+void ParallelEvaluator::evaluateRange( std::uint32_t first, std::uint32_t last ) {
+    checkDeadline();
+    for ( std::uint32_t i = first; i <= last; ++i )
+        values[ i ] = compute( plan[ i ] );
+}
+
+void ParallelEvaluator::evaluateNode( std::uint32_t index ) {
+    const Node& node = plan[ index ];
+    if ( node.cost <= options.grain || node.kind == Kind::LEAF ) {
+        evaluateRange( node.first, index );
+        return;
+    }
+    const Term* term = terms.data() + node.termBegin;
+    switch ( node.kind ) {
+    case Kind::LEAF:
+        break;
+    case Kind::UNARY:
+        evaluateNode( term[ 0 ].child );
+        break;
+    case Kind::BINARY:
+        fork( *options.pool, [ & ] { evaluateNode( term[ 0 ].child ); }, [ & ] { evaluateNode( term[ 1 ].child ); } );
+        break;
+    case Kind::CHAIN:
+        if ( node.merge != Merge::ORDERED ) {
+            values[ index ] = reduce( node, 0, node.termCount );
+            return;
+        }
+        // 不能重排的链条：各项并行求值，之后按顺序合并
+        {
+            auto deadline     = currentDeadline();
+            auto perTask      = static_cast< std::size_t >( static_cast< double >( node.termCount ) * options.grain /
+                                                           node.cost );
+            options.pool->parallelFor(
+                node.termCount,
+                [ & ]( std::size_t begin, std::size_t end ) {
+                    DeadlineScope scope( deadline );
+                    for ( std::size_t k = begin; k < end; ++k )
+                        evaluateNode( term[ k ].child );
+                },
+                std::max< std::size_t >( perTask, 1 ) );
+        }
+        break;
+    }
+    values[ index ] = compute( node );
+}
+
+double ParallelEvaluator::reduce( const Node& node, std::uint32_t lo, std::uint32_t hi ) {
+    const Term* term = terms.data() + node.termBegin;
+    if ( hi - lo == 1 || termCost( node, lo, hi ) <= options.grain ) {
+        for ( std::uint32_t k = lo; k < hi; ++k )
+            evaluateNode( term[ k ].child );
+        return pairwise( node, lo, hi );
+    }
+    std::uint32_t mid = lo + ( hi - lo ) / 2;
+    double a          = 0;
+    double b          = 0;
+    fork( *options.pool, [ & ] { a = reduce( node, lo, mid ); }, [ & ] { b = reduce( node, mid, hi ); } );
+    return node.merge == Merge::SUM ? a + b : a * b;
+}
+
+double ParallelEvaluator::evaluate() {
+    auto root = checkedIndex( plan.size() - 1 );
+    evaluateNode( root );
+    return values[ root ];
+}
+
+double evaluateParallel( const ASTNode& root, const ParallelOptions& options ) {
+    ParallelEvaluator evaluator( root, options );
+    return evaluator.evaluate();
+}
@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cmath>
+#include <simple_calculator/plot_sampler.hpp>
+#include <stdexcept>
+
+namespace {
+    // 粗网格间距(像素)，实际间距向下取整到 2 的幂，使不同视口下的网格点重合以便复用
+    constexpr double BASE_PIXELS = 4;
+    // 细分的最小间距(像素)
+    constexpr double MIN_PIXELS = 1.0 / 8;
+    // 中间点偏离弦线超过该像素数才细分
+    constexpr double TOLERANCE_PIXELS = 0.5;
+    constexpr std::size_t MAX_ROUNDS = 16;
+    // 缓存点数上限为视口宽度的倍数
+    constexpr std::size_t CACHE_COLUMNS = 64;
+}  // namespace
+
+PlotSampler::PlotSampler( const std::string& expression, const std::string& variable )
+    : function( expression, variable ) {}
+
+void PlotSampler::add( std::vector< double >& xs ) {
+    std::sort( xs.begin(), xs.end() );
+    xs.erase( std::unique( xs.begin(), xs.end() ), xs.end() );
+    std::vector< double > ys( xs.size() );
+    std::vector< EvalStatus > status( xs.size() );
+    function.evaluate( xs, ys, status.data() );
+
+    std::size_t middle = points.size();
+    for ( std::size_t i = 0; i < xs.size(); ++i ) {
+        bool valid = status[ i ] == EvalStatus::OK && std::isfinite( ys[ i ] );
+        points.push_back( Point{ xs[ i ], ys[ i ], valid } );
+    }
+    auto byX = []( const Point& l, const Point& r ) { return l.x < r.x; };
+    std::inplace_merge( points.begin(), points.begin() + static_cast< std::ptrdiff_t >( middle ), points.end(), byX );
+    points.erase( std::unique( points.begin(), points.end(), []( const Point& l, const Point& r ) { return l.x == r.x; } ),
+                  points.end() );
+}
+
+void PlotSampler::evict( const PlotViewport& viewport ) {
+    if ( points.size() <= viewport.width * CACHE_COLUMNS )
+        return;
+    // 只保留视口左右各一屏内的点，供来回平移时复用
+    double span = viewport.xmax - viewport.xmin;
+    std::erase_if( points, [ & ]( const Point& p ) { return p.x < viewport.xmin - span || p.x > viewport.xmax + span; } );
+    if ( points.size() > viewport.width * CACHE_COLUMNS )
+        points.clear();
+}
+
+std::vector< PlotColumn > PlotSampler::sample( const PlotViewport& viewport ) {
+    if ( viewport.width == 0 || viewport.height == 0 || !( viewport.xmax > viewport.xmin )
+         || !( viewport.ymax > viewport.ymin ) )
+        throw std::invalid_argument( "Invalid plot viewport" );
+
+    evict( viewport );
+    std::size_t before = function.evaluations();
+    double px          = viewport.pixelWidth();
+    double py          = viewport.pixelHeight();
+    double height      = static_cast< double >( viewport.height );
+    auto byX           = []( const Point& p, double x ) { return p.x < x; };
+
+    // 1. 粗网格：多取左右各一个点，使边缘的列也能连线
+    double step = std::exp2( std::floor( std::log2( BASE_PIXELS * px ) ) );
+    double kmin = std::ceil( viewport.xmin / step ) - 1;
+    double kmax = std::floor( viewport.xmax / step ) + 1;
+    std::vector< double > xs;
+    for ( double k = kmin; k <= kmax; ++k ) {
+        double x = k * step;
+        auto it  = std::lower_bound( points.begin(), points.end(), x, byX );
+        if ( it == points.end() || it->x != x )
+            xs.push_back( x );
+    }
+    if ( !xs.empty() )
+        add( xs );
+
+    // 2. 只在需要的地方二分细分，每一轮的新点合成一批求值
+    double left  = kmin * step;
+    double right = kmax * step;
+    statistics.rounds = 0;
+    for ( std::size_t round = 0; round < MAX_ROUNDS; ++round ) {
+        xs.clear();
+        auto lo = static_cast< std::size_t >( std::lower_bound( points.begin(), points.end(), left, byX ) - points.begin() );
+        auto hi = static_cast< std::size_t >( std::lower_bound( points.begin(), points.end(), right, byX ) - points.begin() );
+        hi      = std::min( hi, points.empty() ? 0 : points.size() - 1 );
+        for ( std::size_t i = lo; i < hi; ++i ) {
+            const Point& a = points[ i ];
+            const Point& b = points[ i + 1 ];
+            if ( b.x - a.x <= MIN_PIXELS * px )
+                continue;
+            bool refine = false;
+            if ( a.valid != b.valid ) {
+                // 定义域边界
+                refine = true;
+            }
+            else if ( a.valid ) {
+                if ( std::abs( b.y - a.y ) / py > height ) {
+                    // 跳变超过一整屏，可能是极点
+                    refine = true;
+                }
+                else if ( i + 2 <= hi && points[ i + 2 ].valid ) {
+                    // b 偏离 a-c 弦线的像素数反映曲率
+                    const Point& c = points[ i + 2 ];
+                    double chord   = a.y + ( c.y - a.y ) * ( b.x - a.x ) / ( c.x - a.x );
+                    if ( std::abs( b.y - chord ) / py > TOLERANCE_PIXELS ) {
+                        refine = true;
+                        if ( c.x - b.x > MIN_PIXELS * px )
+                            xs.push_back( 0.5 * ( b.x + c.x ) );
+                    }
+                }
+            }
+            if ( refine )
+                xs.push_back( 0.5 * ( a.x + b.x ) );
+        }
+        if ( xs.empty() )
+            break;
+        add( xs );
+        ++statistics.rounds;
+    }
+
+    // 3. 标记间断：无定义点之后，或细分之后仍然从屏幕一侧外直接跳到另一侧外(例如 tan 的极点)
+    for ( std::size_t i = 1; i < points.size(); ++i ) {
+        const Point& a = points[ i - 1 ];
+        Point& b       = points[ i ];
+        bool across    = ( a.y > viewport.ymax && b.y < viewport.ymin ) || ( a.y < viewport.ymin && b.y > viewport.ymax );
+        b.breakBefore  = !a.valid || ( b.valid && across );
+    }
+
+    // 4. 按像素列做 min/max 抽取
+    std::vector< PlotColumn > columns( viewport.width );
+    bool pendingBreak = false;
+    auto first = std::lower_bound( points.begin(), points.end(), viewport.xmin, byX );
+    for ( auto it = first; it != points.end() && it->x < viewport.xmax; ++it ) {
+        if ( !it->valid ) {
+            pendingBreak = true;
+            continue;
+        }
+        auto index = std::min( static_cast< std::size_t >( ( it->x - viewport.xmin ) / px ), viewport.width - 1 );
+        PlotColumn& column = columns[ index ];
+        if ( column.samples == 0 || it->breakBefore ) {
+            // 列内出现间断时只保留间断之后的部分，避免竖线穿过极点
+            column = PlotColumn{ 0, it->y, it->y, it->y, it->y, pendingBreak || it->breakBefore || column.samples > 0 };
+        }
+        column.min  = std::min( column.min, it->y );
+        column.max  = std::max( column.max, it->y );
+        column.last = it->y;
+        ++column.samples;
+        pendingBreak = false;
+    }
+
+    statistics.evaluations = function.evaluations() - before;
+    statistics.cached      = points.size();
+    return columns;
+}
@@ -0,0 +1,77 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <optional>
+#include <simple_calculator/precision.hpp>
+#include <vector>
+
+namespace {
+    constexpr double INFINITE_ERROR = std::numeric_limits< double >::infinity();
+
+    // 同一行上 float 结果相对 double 结果的误差；两者都出同样的错时返回空
+    std::optional< double > relativeError( double wide, EvalStatus wideStatus, float narrow, EvalStatus narrowStatus ) {
+        if ( wideStatus != narrowStatus )
+            return INFINITE_ERROR;
+        if ( wideStatus != EvalStatus::OK )
+            return std::nullopt;
+        double value = narrow;
+        if ( value == wide || ( std::isnan( value ) && std::isnan( wide ) ) )
+            return 0.0;
+        if ( !std::isfinite( value ) || !std::isfinite( wide ) )
+            return INFINITE_ERROR;
+        return std::abs( value - wide ) / std::max( std::abs( wide ), double{ std::numeric_limits< float >::min() } );
+    }
+
+    // 回退到 double 时每次求值的行数，中间结果放在每个线程复用的缓冲区里
+    constexpr std::size_t WIDE_CHUNK = 16 * BATCH_BLOCK;
+    thread_local std::vector< double > wideScratch;
+}  // namespace
+
+PrecisionEstimate estimatePrecision( const BatchEvaluator& evaluator, std::size_t rows,
+                                     const PrecisionOptions& options ) {
+    PrecisionEstimate estimate;
+    std::size_t samples = std::min( options.samples, rows );
+    for ( std::size_t k = 0; k < samples; ++k ) {
+        std::size_t row = k * rows / samples;
+        double wide     = 0;
+        float narrow    = 0;
+        EvalStatus wideStatus{};
+        EvalStatus narrowStatus{};
+        evaluator.run( row, 1, &wide, &wideStatus );
+        evaluator.run( row, 1, &narrow, &narrowStatus );
+        auto error = relativeError( wide, wideStatus, narrow, narrowStatus );
+        if ( !error )
+            continue;
+        ++estimate.samples;
+        estimate.maxRelativeError = std::max( estimate.maxRelativeError, *error );
+    }
+    estimate.precision = estimate.maxRelativeError <= options.tolerance ? Precision::FLOAT32 : Precision::FLOAT64;
+    return estimate;
+}
+
+MixedPrecisionEvaluator::MixedPrecisionEvaluator( const BatchProgram& program, std::span< const Column > columns,
+                                                  std::size_t rows, const PrecisionOptions& options )
+    : evaluator( program, columns ), report( estimatePrecision( evaluator, rows, options ) ) {}
+
+void MixedPrecisionEvaluator::run( std::size_t offset, std::size_t count, float* out, EvalStatus* status ) const {
+    if ( report.precision == Precision::FLOAT32 ) {
+        evaluator.run( offset, count, out, status );
+        return;
+    }
+    if ( wideScratch.size() < WIDE_CHUNK )
+        wideScratch.resize( WIDE_CHUNK );
+    for ( std::size_t start = 0; start < count; start += WIDE_CHUNK ) {
+        std::size_t n = std::min( WIDE_CHUNK, count - start );
+        evaluator.run( offset + start, n, wideScratch.data(), status ? status + start : nullptr );
+        std::transform( wideScratch.begin(), wideScratch.begin() + static_cast< std::ptrdiff_t >( n ), out + start,
+                        []( double value ) { return static_cast< float >( value ); } );
+    }
+}
+
+float evaluateFloat( const ASTNode& root ) {
+    BatchProgram program = compileBatch( root );
+    BatchEvaluator evaluator( program, {} );
+    float result = 0;
+    evaluator.run( 0, 1, &result );
+    return result;
+}
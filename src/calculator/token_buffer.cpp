@@ -0,0 +1,385 @@
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <limits>
+#include <simple_calculator/calculator.hpp>
+#include <simple_calculator/token_buffer.hpp>
+#include <stdexcept>
+#include <system_error>
+
+#if defined( __x86_64__ ) || defined( _M_X64 )
+#include <immintrin.h>
+#define CALCULATOR_TOKENIZER_X86 1
+#if defined( __GNUC__ )
+#define CALCULATOR_TOKENIZER_AVX2 1
+#endif
+#endif
+
+namespace {
+    constexpr std::size_t BLOCK = 64;
+
+    // 一个 64 字节块中各字符类别的位掩码，第 i 位对应块内第 i 个字节
+    struct Masks {
+        std::uint64_t space      = 0;  // 空白(与 std::isspace 相同)
+        std::uint64_t number     = 0;  // 数字或 .
+        std::uint64_t identifier = 0;  // 字母、数字或 _
+        std::uint64_t symbol     = 0;  // 单字符运算符和分隔符
+    };
+
+    // 单字符 token 及其类型
+    constexpr std::string_view SYMBOLS = "+-*/^%!(),;=<>";
+    constexpr std::array< TokenType, SYMBOLS.size() > SYMBOL_TYPES{
+        TokenType::OP_PLUS, TokenType::OP_MINUS,     TokenType::OP_MUL,    TokenType::OP_DIV,
+        TokenType::OP_POW,  TokenType::OP_MOD,       TokenType::OP_FACTORIAL, TokenType::LPAREN,
+        TokenType::RPAREN,  TokenType::COMMA,        TokenType::SEMICOLON, TokenType::ASSIGN,
+        TokenType::OP_LT,   TokenType::OP_GT,
+    };
+
+    // 后面紧跟 = 时组成的双字符比较运算符，没有则返回 END
+    constexpr TokenType withEquals( char c ) {
+        switch ( c ) {
+        case '<':
+            return TokenType::OP_LE;
+        case '>':
+            return TokenType::OP_GE;
+        case '=':
+            return TokenType::OP_EQ;
+        case '!':
+            return TokenType::OP_NE;
+        default:
+            return TokenType::END;
+        }
+    }
+
+    constexpr std::array< TokenType, 256 > makeSymbolTable() {
+        std::array< TokenType, 256 > table{};
+        for ( std::size_t i = 0; i < SYMBOLS.size(); ++i )
+            table[ static_cast< unsigned char >( SYMBOLS[ i ] ) ] = SYMBOL_TYPES[ i ];
+        return table;
+    }
+    constexpr auto SYMBOL_TABLE = makeSymbolTable();
+
+    // 10^0 .. 10^22 都能被 double 精确表示
+    constexpr std::array< double, 23 > POWERS_OF_TEN{
+        1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+    };
+
+    // 快速路径：最多 15 位有效数字且至多一个小数点时，尾数和 10 的幂都能精确表示，
+    // 一次除法即得到正确舍入的结果，与 strtod 完全一致。其余情况返回 false 交给 from_chars
+    bool fastNumber( std::string_view text, double& value ) {
+        std::uint64_t mantissa = 0;
+        std::size_t digits     = 0;
+        std::size_t fraction   = 0;
+        bool dot               = false;
+        for ( char c : text ) {
+            if ( c == '.' ) {
+                if ( dot )
+                    return false;
+                dot = true;
+                continue;
+            }
+            if ( ++digits > 15 )
+                return false;
+            mantissa = mantissa * 10 + static_cast< std::uint64_t >( c - '0' );
+            fraction += dot ? 1 : 0;
+        }
+        if ( digits == 0 )
+            return false;
+        value = static_cast< double >( mantissa ) / POWERS_OF_TEN[ fraction ];
+        return true;
+    }
+
+#ifndef CALCULATOR_TOKENIZER_X86
+    // 非 x86 平台的标量实现：查表分类
+    enum CharClass : std::uint8_t { SPACE = 1, NUMBER = 2, IDENTIFIER = 4, SYMBOL = 8 };
+
+    constexpr std::array< std::uint8_t, 256 > makeClassTable() {
+        std::array< std::uint8_t, 256 > table{};
+        for ( unsigned c = 0; c < 256; ++c ) {
+            std::uint8_t cls = 0;
+            if ( c == ' ' || ( c >= '\t' && c <= '\r' ) )
+                cls |= SPACE;
+            if ( ( c >= '0' && c <= '9' ) || c == '.' )
+                cls |= NUMBER;
+            if ( ( c >= '0' && c <= '9' ) || ( c >= 'a' && c <= 'z' ) || ( c >= 'A' && c <= 'Z' ) || c == '_' )
+                cls |= IDENTIFIER;
+            if ( SYMBOLS.find( static_cast< char >( c ) ) != std::string_view::npos )
+                cls |= SYMBOL;
+            table[ c ] = cls;
+        }
+        return table;
+    }
+    constexpr auto CLASS_TABLE = makeClassTable();
+
+    Masks classifyScalar( const char* p ) {
+        Masks m;
+        for ( std::size_t i = 0; i < BLOCK; ++i ) {
+            std::uint8_t cls = CLASS_TABLE[ static_cast< unsigned char >( p[ i ] ) ];
+            m.space |= static_cast< std::uint64_t >( ( cls & SPACE ) != 0 ) << i;
+            m.number |= static_cast< std::uint64_t >( ( cls & NUMBER ) != 0 ) << i;
+            m.identifier |= static_cast< std::uint64_t >( ( cls & IDENTIFIER ) != 0 ) << i;
+            m.symbol |= static_cast< std::uint64_t >( ( cls & SYMBOL ) != 0 ) << i;
+        }
+        return m;
+    }
+#endif
+
+#ifdef CALCULATOR_TOKENIZER_X86
+    // SIMD 分类：字节按有符号比较，>= 0x80 的字节为负数，不会落入任何区间。
+    // V 封装 SSE2 或 AVX2 的 load/比较/movemask，一个块由 64 / V::WIDTH 个向量组成。
+    // AVX2 版本需要 target 属性才能内联 AVX2 指令，因此用宏为两个版本各生成一个函数
+#define CALCULATOR_SIMD_CLASSIFY( NAME, V, TARGET )                                                                     \
+    TARGET Masks NAME( const char* p ) {                                                                                \
+        Masks m;                                                                                                        \
+        for ( std::size_t offset = 0; offset < BLOCK; offset += V::WIDTH ) {                                            \
+            auto x      = V::load( p + offset );                                                                        \
+            auto lower  = V::bitOr( x, V::splat( 0x20 ) );                                                              \
+            auto digit  = V::range( x, '0', '9' );                                                                      \
+            auto letter = V::range( lower, 'a', 'z' );                                                                  \
+            auto space  = V::bitOr( V::equal( x, ' ' ), V::range( x, '\t', '\r' ) );                                   \
+            auto number = V::bitOr( digit, V::equal( x, '.' ) );                                                        \
+            auto ident  = V::bitOr( V::bitOr( digit, letter ), V::equal( x, '_' ) );                                    \
+            auto symbol = V::equal( x, SYMBOLS[ 0 ] );                                                                  \
+            for ( std::size_t s = 1; s < SYMBOLS.size(); ++s )                                                          \
+                symbol = V::bitOr( symbol, V::equal( x, SYMBOLS[ s ] ) );                                               \
+            m.space |= V::mask( space ) << offset;                                                                      \
+            m.number |= V::mask( number ) << offset;                                                                    \
+            m.identifier |= V::mask( ident ) << offset;                                                                 \
+            m.symbol |= V::mask( symbol ) << offset;                                                                    \
+        }                                                                                                               \
+        return m;                                                                                                       \
+    }
+
+    struct Sse2 {
+        using Vec                        = __m128i;
+        static constexpr std::size_t WIDTH = 16;
+        static Vec load( const char* p ) {
+            return _mm_loadu_si128( reinterpret_cast< const __m128i* >( p ) );
+        }
+        static Vec splat( char c ) {
+            return _mm_set1_epi8( c );
+        }
+        static Vec equal( Vec x, char c ) {
+            return _mm_cmpeq_epi8( x, _mm_set1_epi8( c ) );
+        }
+        static Vec range( Vec x, char lo, char hi ) {
+            return _mm_and_si128( _mm_cmpgt_epi8( x, _mm_set1_epi8( static_cast< char >( lo - 1 ) ) ),
+                                  _mm_cmplt_epi8( x, _mm_set1_epi8( static_cast< char >( hi + 1 ) ) ) );
+        }
+        static Vec bitOr( Vec a, Vec b ) {
+            return _mm_or_si128( a, b );
+        }
+        static std::uint64_t mask( Vec x ) {
+            return static_cast< std::uint16_t >( _mm_movemask_epi8( x ) );
+        }
+    };
+    CALCULATOR_SIMD_CLASSIFY( classifySse2, Sse2, inline )
+
+#ifdef CALCULATOR_TOKENIZER_AVX2
+#define CALCULATOR_AVX2 __attribute__( ( target( "avx2" ) ) )
+    struct Avx2 {
+        using Vec                        = __m256i;
+        static constexpr std::size_t WIDTH = 32;
+        CALCULATOR_AVX2 static Vec load( const char* p ) {
+            return _mm256_loadu_si256( reinterpret_cast< const __m256i* >( p ) );
+        }
+        CALCULATOR_AVX2 static Vec splat( char c ) {
+            return _mm256_set1_epi8( c );
+        }
+        CALCULATOR_AVX2 static Vec equal( Vec x, char c ) {
+            return _mm256_cmpeq_epi8( x, _mm256_set1_epi8( c ) );
+        }
+        CALCULATOR_AVX2 static Vec range( Vec x, char lo, char hi ) {
+            return _mm256_and_si256( _mm256_cmpgt_epi8( x, _mm256_set1_epi8( static_cast< char >( lo - 1 ) ) ),
+                                     _mm256_cmpgt_epi8( _mm256_set1_epi8( static_cast< char >( hi + 1 ) ), x ) );
+        }
+        CALCULATOR_AVX2 static Vec bitOr( Vec a, Vec b ) {
+            return _mm256_or_si256( a, b );
+        }
+        CALCULATOR_AVX2 static std::uint64_t mask( Vec x ) {
+            return static_cast< std::uint32_t >( _mm256_movemask_epi8( x ) );
+        }
+    };
+    CALCULATOR_SIMD_CLASSIFY( classifyAvx2, Avx2, CALCULATOR_AVX2 )
+#endif
+#undef CALCULATOR_SIMD_CLASSIFY
+#endif
+
+    using Classifier = Masks ( * )( const char* );
+
+    struct Backend {
+        Classifier classify;
+        const char* name;
+    };
+
+    Backend selectBackend() {
+#ifdef CALCULATOR_TOKENIZER_AVX2
+        if ( __builtin_cpu_supports( "avx2" ) )
+            return { classifyAvx2, "avx2" };
+#endif
+#ifdef CALCULATOR_TOKENIZER_X86
+        return { classifySse2, "sse2" };
+#else
+        return { classifyScalar, "scalar" };
+#endif
+    }
+
+    const Backend& backend() {
+        static const Backend selected = selectBackend();
+        return selected;
+    }
+
+    // 按块缓存掩码；最后一个不完整的块拷贝到补零的缓冲区，补零的字节不属于任何类别
+    class Scanner {
+        std::string_view input;
+        Classifier classify;
+        std::size_t current = std::numeric_limits< std::size_t >::max();
+        Masks masks;
+
+    public:
+        Scanner( std::string_view in, Classifier c ) : input( in ), classify( c ) {}
+
+        const Masks& at( std::size_t block ) {
+            if ( block != current ) {
+                std::size_t begin = block * BLOCK;
+                if ( begin + BLOCK <= input.size() ) {
+                    masks = classify( input.data() + begin );
+                }
+                else {
+                    std::array< char, BLOCK > tail{};
+                    std::memcpy( tail.data(), input.data() + begin, input.size() - begin );
+                    masks = classify( tail.data() );
+                }
+                current = block;
+            }
+            return masks;
+        }
+
+        // 从 pos 开始属于 member 类别的连续字节数
+        std::size_t run( std::uint64_t Masks::*member, std::size_t pos ) {
+            std::size_t start = pos;
+            for ( ;; ) {
+                std::size_t bit    = pos % BLOCK;
+                std::uint64_t bits = at( pos / BLOCK ).*member >> bit;
+                auto ones          = static_cast< std::size_t >( std::countr_one( bits ) );
+                pos += ones;
+                if ( ones < BLOCK - bit )
+                    return pos - start;
+            }
+        }
+    };
+
+    TokenType keyword( std::string_view word ) {
+        // clang-format off
+        static constexpr std::array< std::pair< std::string_view, TokenType >, 16 > keywords{ {
+            { "sqrt", TokenType::FUNC_SQRT }, { "sin", TokenType::FUNC_SIN }, { "cos", TokenType::FUNC_COS },
+            { "tan", TokenType::FUNC_TAN },   { "lg", TokenType::FUNC_LG },   { "ln", TokenType::FUNC_LN },
+            { "sum", TokenType::FUNC_SUM },   { "mean", TokenType::FUNC_MEAN }, { "min", TokenType::FUNC_MIN },
+            { "max", TokenType::FUNC_MAX },   { "dot", TokenType::FUNC_DOT }, { "pi", TokenType::CONST_PI },
+            { "e", TokenType::CONST_E },      { "if", TokenType::FUNC_IF },   { "abs", TokenType::FUNC_ABS },
+            { "clamp", TokenType::FUNC_CLAMP },
+        } };
+        // clang-format on
+        if ( word.size() <= 5 ) {
+            for ( const auto& [ name, type ] : keywords )
+                if ( name == word )
+                    return type;
+        }
+        return TokenType::IDENTIFIER;
+    }
+}  // namespace
+
+const char* tokenizerBackend() {
+    return backend().name;
+}
+
+TokenBuffer tokenize( std::string_view input ) {
+    if ( input.size() > std::numeric_limits< std::uint32_t >::max() )
+        throw std::runtime_error( "Input too large for bulk tokenization" );
+
+    TokenBuffer buffer;
+    // 直接写入局部指针，容量不足时成倍扩容；比三个 push_back 少了大量的容量检查和指针回写
+    std::size_t count    = 0;
+    std::uint8_t* types  = nullptr;
+    std::uint32_t* offs  = nullptr;
+    std::uint32_t* lens  = nullptr;
+    auto grow            = [ & ] {
+        std::size_t capacity = std::max< std::size_t >( buffer.types.size() * 2, input.size() / 4 + BLOCK );
+        buffer.types.resize( capacity );
+        buffer.offsets.resize( capacity );
+        buffer.lengths.resize( capacity );
+        types = buffer.types.data();
+        offs  = buffer.offsets.data();
+        lens  = buffer.lengths.data();
+    };
+    auto push = [ & ]( TokenType type, std::size_t offset, std::size_t length ) {
+        if ( count == buffer.types.size() )
+            grow();
+        types[ count ] = static_cast< std::uint8_t >( type );
+        offs[ count ]  = static_cast< std::uint32_t >( offset );
+        lens[ count ]  = static_cast< std::uint32_t >( length );
+        ++count;
+    };
+    auto fail = [ & ]( std::string message ) {
+        buffer.failed = true;
+        buffer.error  = std::move( message );
+    };
+
+    Scanner scanner( input, backend().classify );
+    std::size_t pos = 0;
+    while ( pos < input.size() ) {
+        const Masks& m    = scanner.at( pos / BLOCK );
+        std::uint64_t bit = std::uint64_t{ 1 } << ( pos % BLOCK );
+        if ( m.space & bit ) {
+            pos += scanner.run( &Masks::space, pos );
+        }
+        else if ( m.number & bit ) {
+            std::size_t length    = scanner.run( &Masks::number, pos );
+            std::string_view text = input.substr( pos, length );
+            double value          = 0;
+            if ( !fastNumber( text, value ) ) {
+                // 与 std::stod 一致：解析最长的合法前缀，多余的 . 被忽略
+                auto [ end, ec ] = std::from_chars( text.data(), text.data() + text.size(), value );
+                static_cast< void >( end );
+                if ( ec == std::errc::result_out_of_range ) {
+                    fail( "Number out of range: " + std::string( text ) );
+                    break;
+                }
+                if ( ec != std::errc() ) {
+                    fail( "Invalid number: " + std::string( text ) );
+                    break;
+                }
+            }
+            push( TokenType::NUMBER, pos, length );
+            buffer.values.push_back( value );
+            pos += length;
+        }
+        else if ( m.identifier & bit ) {
+            // 数字已在上面处理，这里一定以字母或 _ 开头
+            std::size_t length = scanner.run( &Masks::identifier, pos );
+            push( keyword( input.substr( pos, length ) ), pos, length );
+            pos += length;
+        }
+        else if ( m.symbol & bit ) {
+            TokenType paired = withEquals( input[ pos ] );
+            if ( paired != TokenType::END && pos + 1 < input.size() && input[ pos + 1 ] == '=' ) {
+                push( paired, pos, 2 );
+                pos += 2;
+            }
+            else {
+                push( SYMBOL_TABLE[ static_cast< unsigned char >( input[ pos ] ) ], pos, 1 );
+                ++pos;
+            }
+        }
+        else {
+            fail( "Invalid character: " + std::string( 1, input[ pos ] ) );
+            break;
+        }
+    }
+    buffer.types.resize( count );
+    buffer.offsets.resize( count );
+    buffer.lengths.resize( count );
+    return buffer;
+}
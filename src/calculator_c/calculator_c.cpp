@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <simple_calculator/batch.hpp>
+#include <simple_calculator/budget.hpp>
+#include <simple_calculator/calculator.hpp>
+#include <simple_calculator/calculator_c.h>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// sc_column 和逐元素错误码直接按 Column 和 EvalStatus 传给批量求值器，两边的布局和数值必须一致
+static_assert( std::is_standard_layout_v< sc_column > && std::is_standard_layout_v< Column > );
+static_assert( sizeof( sc_column ) == sizeof( Column ) );
+static_assert( offsetof( sc_column, data ) == offsetof( Column, data ) );
+static_assert( offsetof( sc_column, stride ) == offsetof( Column, stride ) );
+static_assert( sizeof( EvalStatus ) == sizeof( std::uint8_t ) );
+static_assert( static_cast< int >( EvalStatus::DIVISION_BY_ZERO ) == SC_DIVISION_BY_ZERO );
+static_assert( static_cast< int >( EvalStatus::MODULO_BY_ZERO ) == SC_MODULO_BY_ZERO );
+static_assert( static_cast< int >( EvalStatus::SQRT_NEGATIVE ) == SC_SQRT_NEGATIVE );
+static_assert( static_cast< int >( EvalStatus::TAN_UNDEFINED ) == SC_TAN_UNDEFINED );
+static_assert( static_cast< int >( EvalStatus::LG_NON_POSITIVE ) == SC_LG_NON_POSITIVE );
+static_assert( static_cast< int >( EvalStatus::LN_NON_POSITIVE ) == SC_LN_NON_POSITIVE );
+static_assert( static_cast< int >( EvalStatus::FACTORIAL_NEGATIVE ) == SC_FACTORIAL_NEGATIVE );
+static_assert( static_cast< int >( EvalStatus::FACTORIAL_NON_INTEGER ) == SC_FACTORIAL_NON_INTEGER );
+
+struct sc_expression {
+    std::unique_ptr< ASTNode > ast;
+    // calls 指向 ast 中的标量子树，它们的值在编译时算好
+    BatchProgram program;
+    std::vector< double > callValues;
+    std::size_t columns = 0;
+};
+
+namespace {
+    void copyMessage( const char* message, char* error, std::size_t capacity ) {
+        if ( !error || capacity == 0 )
+            return;
+        std::size_t length = std::min( std::strlen( message ), capacity - 1 );
+        std::memcpy( error, message, length );
+        error[ length ] = '\0';
+    }
+}  // namespace
+
+extern "C" {
+
+uint32_t sc_abi_version( void ) {
+    return SC_ABI_VERSION;
+}
+
+const char* sc_status_message( sc_status status ) {
+    switch ( status ) {
+    case SC_INVALID_ARGUMENT:
+        return "Invalid argument";
+    case SC_PARSE_ERROR:
+        return "Parse error";
+    case SC_OUT_OF_MEMORY:
+        return "Out of memory";
+    case SC_INTERNAL_ERROR:
+        return "Internal error";
+    default:
+        if ( status >= SC_OK && status <= SC_FACTORIAL_NON_INTEGER )
+            return evalStatusMessage( static_cast< EvalStatus >( status ) );
+        return "Unknown error";
+    }
+}
+
+sc_status sc_compile( const char* source, size_t length, const char* const* columns, size_t column_count,
+                      sc_expression** out, char* error, size_t error_capacity ) {
+    if ( !out )
+        return SC_INVALID_ARGUMENT;
+    *out = nullptr;
+    if ( ( !source && length > 0 ) || ( !columns && column_count > 0 ) ||
+         std::any_of( columns, columns + column_count, []( const char* name ) { return !name; } ) ) {
+        copyMessage( "Invalid argument", error, error_capacity );
+        return SC_INVALID_ARGUMENT;
+    }
+    try {
+        auto expression = std::make_unique< sc_expression >();
+        std::vector< std::string > names( columns, columns + column_count );
+        Lexer lexer( std::string( source, length ) );
+        // 按默认预算限制 token 数，超长的表达式在解析时就被拒绝，不会占用大量内存和编译时间
+        lexer.limitTokens( ResourceBudget{}.maxTokens );
+        Parser parser( lexer, [ &names ]( const std::string& name ) -> std::unique_ptr< ASTNode > {
+            if ( std::find( names.begin(), names.end(), name ) == names.end() )
+                return nullptr;
+            return std::make_unique< VariableNode >( name, nullptr );
+        } );
+        expression->ast     = parser.parse();
+        expression->program = compileBatch( *expression->ast, names );
+        foldConstants( expression->program );
+        for ( const ASTNode* node : expression->program.calls )
+            expression->callValues.push_back( node->evaluate() );
+        expression->columns = column_count;
+        *out                = expression.release();
+        return SC_OK;
+    }
+    catch ( const std::bad_alloc& ) {
+        copyMessage( "Out of memory", error, error_capacity );
+        return SC_OUT_OF_MEMORY;
+    }
+    catch ( const std::exception& e ) {
+        copyMessage( e.what(), error, error_capacity );
+        return SC_PARSE_ERROR;
+    }
+    catch ( ... ) {
+        copyMessage( "Internal error", error, error_capacity );
+        return SC_INTERNAL_ERROR;
+    }
+}
+
+void sc_release( sc_expression* expression ) {
+    delete expression;
+}
+
+size_t sc_column_count( const sc_expression* expression ) {
+    return expression ? expression->columns : 0;
+}
+
+sc_status sc_evaluate( const sc_expression* expression, const sc_column* inputs, size_t input_count, size_t rows,
+                       double* out, ptrdiff_t out_stride, uint8_t* element_status ) {
+    if ( !expression || input_count < expression->columns || ( !inputs && input_count > 0 ) ||
+         ( !out && rows > 0 ) ||
+         std::any_of( inputs, inputs + expression->columns, []( const sc_column& column ) { return !column.data; } ) )
+        return SC_INVALID_ARGUMENT;
+    try {
+        std::span< const Column > columns( reinterpret_cast< const Column* >( inputs ), input_count );
+        ProgramView program{ expression->program.code, expression->program.maxDepth };
+        if ( element_status ) {
+            runProgram( program, columns, expression->callValues, 0, rows, out, out_stride,
+                        reinterpret_cast< EvalStatus* >( element_status ) );
+            return SC_OK;
+        }
+        // 没有错误码缓冲区时逐块求值，在第一个出错的块停下
+        EvalStatus status[ BATCH_BLOCK ];
+        for ( std::size_t start = 0; start < rows; start += BATCH_BLOCK ) {
+            std::size_t n = std::min( BATCH_BLOCK, rows - start );
+            runProgram( program, columns, expression->callValues, start, n,
+                        out + static_cast< std::ptrdiff_t >( start ) * out_stride, out_stride, status );
+            auto failed = std::find_if( status, status + n, []( EvalStatus s ) { return s != EvalStatus::OK; } );
+            if ( failed != status + n )
+                return static_cast< sc_status >( *failed );
+        }
+        return SC_OK;
+    }
+    catch ( const std::bad_alloc& ) {
+        return SC_OUT_OF_MEMORY;
+    }
+    catch ( ... ) {
+        return SC_INTERNAL_ERROR;
+    }
+}
+
+}  // extern "C"
@@ -0,0 +1,85 @@
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <simple_calculator/bundle.hpp>
+#include <string>
+
+// 公式包工具
+//   formula_bundle build <公式文件> <输出文件> [--no-fold]
+//     公式文件每行一个 "名字 = 表达式"，空行和以 # 开头的行被忽略
+//   formula_bundle list <公式包>
+//     完整校验公式包并列出每个公式的输入列和指令数
+namespace {
+    std::string trim( const std::string& s ) {
+        auto begin = s.find_first_not_of( " \t\r" );
+        if ( begin == std::string::npos )
+            return {};
+        auto end = s.find_last_not_of( " \t\r" );
+        return s.substr( begin, end - begin + 1 );
+    }
+
+    int build( const std::string& input, const std::string& output, bool fold ) {
+        std::ifstream in( input );
+        if ( !in ) {
+            std::cerr << std::format( "cannot open {}\n", input );
+            return 1;
+        }
+        BundleWriter writer( fold );
+        std::string line;
+        int errors = 0;
+        for ( std::size_t number = 1; std::getline( in, line ); ++number ) {
+            line = trim( line );
+            if ( line.empty() || line.front() == '#' )
+                continue;
+            auto eq = line.find( '=' );
+            if ( eq == std::string::npos ) {
+                std::cerr << std::format( "{}:{}: expected \"name = expression\"\n", input, number );
+                ++errors;
+                continue;
+            }
+            try {
+                writer.add( trim( line.substr( 0, eq ) ), line.substr( eq + 1 ) );
+            }
+            catch ( const std::exception& e ) {
+                std::cerr << std::format( "{}:{}: {}\n", input, number, e.what() );
+                ++errors;
+            }
+        }
+        if ( errors > 0 )
+            return 1;
+        writer.write( output );
+        std::cout << std::format( "wrote {} formulas to {}\n", writer.size(), output );
+        return 0;
+    }
+
+    int list( const std::string& path ) {
+        auto bundle = FormulaBundle::open( path, BundleCheck::FULL );
+        for ( std::size_t i = 0; i < bundle.size(); ++i ) {
+            auto formula = bundle.at( i );
+            std::string columns;
+            for ( std::size_t c = 0; c < formula.columnCount(); ++c )
+                columns += std::string( c > 0 ? ", " : "" ) + std::string( formula.column( c ) );
+            std::cout << std::format( "{}({})  {} instructions\n", formula.name(), columns,
+                                      formula.program().code.size() );
+        }
+        return 0;
+    }
+}  // namespace
+
+int main( int argc, char* argv[] ) {
+    try {
+        if ( argc >= 4 && std::strcmp( argv[ 1 ], "build" ) == 0 )
+            return build( argv[ 2 ], argv[ 3 ], !( argc > 4 && std::strcmp( argv[ 4 ], "--no-fold" ) == 0 ) );
+        if ( argc == 3 && std::strcmp( argv[ 1 ], "list" ) == 0 )
+            return list( argv[ 2 ] );
+    }
+    catch ( const std::exception& e ) {
+        std::cerr << e.what() << '\n';
+        return 1;
+    }
+    std::cerr << std::format( "usage: {} build <formulas.txt> <output.bundle> [--no-fold]\n"
+                              "       {} list <bundle>\n",
+                              argv[ 0 ], argv[ 0 ] );
+    return 2;
+}
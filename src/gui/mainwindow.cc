@@ -16,7 +16,7 @@
 MainWindow::MainWindow( QWidget* parent ) : QMainWindow( parent ) {
     // 设置窗口标题和大小
     setWindowTitle( "简易计算器" );
-    setFixedSize( 400, 500 );
+    setFixedSize( 400, 800 );
 
     // 创建主部件和布局
     auto* centralWidget = new QWidget( this );
@@ -32,7 +32,7 @@ MainWindow::MainWindow( QWidget* parent ) : QMainWindow( parent ) {
     // 创建按钮
     // clang-format off
     QStringList buttonLabels = {
-    	"lg","ln","10^", "e^"," ",
+    	"lg","ln","10^", "e^","x",
     	"π","e","Ans","C","⌫",
     	"sin","(", ")","n!","/",
     	"cos","7", "8", "9","*",
@@ -58,6 +58,12 @@ MainWindow::MainWindow( QWidget* parent ) : QMainWindow( parent ) {
         // 连接按钮点击信号到槽函数
         connect( button, &QPushButton::clicked, this, &MainWindow::onButtonClicked );
     }
+    // 函数图像面板
+    this->plotView = new PlotView( this );
+    this->plotView->setSizePolicy( QSizePolicy::Expanding, QSizePolicy::Expanding );
+    layout->addWidget( this->plotView, static_cast< int >( buttonLabels.size() ) / 5 + 1, 0, 1, 5 );
+    layout->setRowStretch( static_cast< int >( buttonLabels.size() ) / 5 + 1, 4 );
+
     layout->setSpacing( 3 );
     layout->setContentsMargins( 15, 15, 15, 15 );
 }
@@ -81,15 +87,17 @@ void MainWindow::onButtonClicked() {
         displayText.replace( "π", "pi" );
         // replace "√" with "sqrt"
         displayText.replace( "√", "sqrt" );
-        // replace "Ans" with lastResult
-        displayText.replace( "Ans", QString::number( this->lastResult ) );
-        // start calculating
+        // expressions in 'x' are handed to the plot panel
+        if ( displayText.contains( "x" ) ) {
+            this->plotView->setExpression( displayText );
+            this->displayer->setResult( "y = f(x)" );
+            return;
+        }
+        // start calculating, "Ans" is resolved to its script register at compile time
         try {
-            Lexer lexer( displayText.toStdString() );
-            Parser parser( lexer );
-            auto ast         = parser.parse();
-            double result    = ast->evaluate();
-            this->lastResult = result;
+            this->script.compile( displayText.toStdString() );
+            double result = this->script.run();
+            this->script.set( this->ansSlot, result );
             this->displayer->setResult( QString::number( result ) );
         }
         catch ( const std::exception& e ) {
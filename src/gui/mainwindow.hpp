@@ -6,6 +6,7 @@
 #include <simple_calculator/calculator.hpp>
 
 #include "displayer.hpp"
+#include "plotview.hpp"
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -16,8 +17,11 @@ public:
 
 private:
     Displayer* displayer;
-    // For 'Ans' function
-    double lastResult = 0.0;
+    // Expressions in 'x' are plotted here instead of being evaluated
+    PlotView* plotView;
+    // For 'Ans' function: a predefined script register that survives recompiles
+    Script script{ { "Ans" } };
+    std::size_t ansSlot = *script.slotOf( "Ans" );
 
 private slots:
     void onButtonClicked();
@@ -0,0 +1,202 @@
+#include "plotview.hpp"
+
+#include <QMouseEvent>
+#include <QPainter>
+#include <QPainterPath>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+PlotWorker::PlotWorker( QObject* parent ) : QObject( parent ) {}
+
+PlotWorker::~PlotWorker() = default;
+
+void PlotWorker::setExpression( const QString& expr ) {
+    try {
+        this->sampler = std::make_unique< PlotSampler >( expr.toStdString(), "x" );
+    }
+    catch ( const std::exception& e ) {
+        this->sampler.reset();
+        emit failed( QString::fromStdString( e.what() ) );
+    }
+}
+
+void PlotWorker::sample( const PlotViewport& viewport ) {
+    if ( !this->sampler ) {
+        emit sampled( viewport, {} );
+        return;
+    }
+    try {
+        emit sampled( viewport, this->sampler->sample( viewport ) );
+    }
+    catch ( const std::exception& e ) {
+        emit failed( QString::fromStdString( e.what() ) );
+        emit sampled( viewport, {} );
+    }
+}
+
+PlotView::PlotView( QWidget* parent ) : QWidget( parent ), worker( new PlotWorker ) {
+    qRegisterMetaType< PlotViewport >();
+    qRegisterMetaType< std::vector< PlotColumn > >();
+
+    this->setMinimumHeight( 200 );
+    this->setMouseTracking( false );
+
+    // worker 在工作线程上运行，信号以排队方式跨线程传递
+    this->worker->moveToThread( &this->workerThread );
+    connect( &this->workerThread, &QThread::finished, this->worker, &QObject::deleteLater );
+    connect( this, &PlotView::expressionChanged, this->worker, &PlotWorker::setExpression );
+    connect( this, &PlotView::sampleRequested, this->worker, &PlotWorker::sample );
+    connect( this->worker, &PlotWorker::sampled, this, &PlotView::onSampled );
+    connect( this->worker, &PlotWorker::failed, this, &PlotView::onFailed );
+    this->workerThread.start();
+}
+
+PlotView::~PlotView() {
+    this->workerThread.quit();
+    this->workerThread.wait();
+}
+
+void PlotView::setExpression( const QString& expr ) {
+    this->expression = expr;
+    this->error.clear();
+    this->columns.clear();
+    emit expressionChanged( expr );
+    this->requestSample();
+    this->update();
+}
+
+void PlotView::requestSample() {
+    if ( this->expression.isEmpty() || this->viewport.width == 0 || this->viewport.height == 0 )
+        return;
+    if ( this->busy ) {
+        this->pending = true;
+        return;
+    }
+    this->busy = true;
+    emit sampleRequested( this->viewport );
+}
+
+void PlotView::onSampled( const PlotViewport& sampledViewport, const std::vector< PlotColumn >& sampledColumns ) {
+    this->busy            = false;
+    this->columnsViewport = sampledViewport;
+    this->columns         = sampledColumns;
+    if ( this->pending ) {
+        this->pending = false;
+        this->requestSample();
+    }
+    this->update();
+}
+
+void PlotView::onFailed( const QString& message ) {
+    this->error = message;
+    this->update();
+}
+
+void PlotView::paintEvent( QPaintEvent* /*event*/ ) {
+    QPainter painter( this );
+    painter.fillRect( this->rect(), Qt::white );
+
+    const PlotViewport& view = this->viewport;
+    double px                = view.pixelWidth();
+    double py                = view.pixelHeight();
+    double height            = static_cast< double >( view.height );
+    auto toScreenX           = [ & ]( double x ) { return ( x - view.xmin ) / px; };
+    // 远离屏幕的点截断到屏幕上下各一屏内，避免极大的坐标
+    auto toScreenY = [ & ]( double y ) { return std::clamp( ( view.ymax - y ) / py, -height, 2 * height ); };
+
+    // 坐标轴
+    painter.setPen( QPen( Qt::gray, 1 ) );
+    if ( view.xmin < 0 && view.xmax > 0 )
+        painter.drawLine( QPointF( toScreenX( 0 ), 0 ), QPointF( toScreenX( 0 ), height ) );
+    if ( view.ymin < 0 && view.ymax > 0 )
+        painter.drawLine( QPointF( 0, toScreenY( 0 ) ), QPointF( static_cast< double >( view.width ), toScreenY( 0 ) ) );
+
+    if ( !this->error.isEmpty() ) {
+        painter.setPen( Qt::red );
+        painter.drawText( this->rect(), Qt::AlignCenter, this->error );
+        return;
+    }
+
+    // 每个像素列画一条 min-max 竖线，并与左侧最近的有样本列相连
+    const PlotViewport& source = this->columnsViewport;
+    double sourcePx            = source.pixelWidth();
+    QPainterPath path;
+    bool connected = false;
+    for ( std::size_t i = 0; i < this->columns.size(); ++i ) {
+        const PlotColumn& column = this->columns[ i ];
+        if ( column.samples == 0 )
+            continue;
+        double x = toScreenX( source.xmin + ( static_cast< double >( i ) + 0.5 ) * sourcePx );
+        if ( connected && !column.breakBefore )
+            path.lineTo( x, toScreenY( column.first ) );
+        else
+            path.moveTo( x, toScreenY( column.first ) );
+        if ( column.min != column.max ) {
+            path.moveTo( x, toScreenY( column.min ) );
+            path.lineTo( x, toScreenY( column.max ) );
+            path.moveTo( x, toScreenY( column.last ) );
+        }
+        connected = true;
+    }
+    painter.setRenderHint( QPainter::Antialiasing );
+    painter.setPen( QPen( Qt::blue, 1.5 ) );
+    painter.drawPath( path );
+}
+
+void PlotView::resizeEvent( QResizeEvent* /*event*/ ) {
+    // 保持中心和单位像素长度不变
+    double cx = 0.5 * ( this->viewport.xmin + this->viewport.xmax );
+    double cy = 0.5 * ( this->viewport.ymin + this->viewport.ymax );
+    double px = this->viewport.pixelWidth();
+    double py = this->viewport.pixelHeight();
+
+    this->viewport.width  = static_cast< std::size_t >( std::max( this->width(), 1 ) );
+    this->viewport.height = static_cast< std::size_t >( std::max( this->height(), 1 ) );
+    this->viewport.xmin   = cx - 0.5 * px * static_cast< double >( this->viewport.width );
+    this->viewport.xmax   = cx + 0.5 * px * static_cast< double >( this->viewport.width );
+    this->viewport.ymin   = cy - 0.5 * py * static_cast< double >( this->viewport.height );
+    this->viewport.ymax   = cy + 0.5 * py * static_cast< double >( this->viewport.height );
+    this->requestSample();
+}
+
+void PlotView::mousePressEvent( QMouseEvent* event ) {
+    if ( event->button() == Qt::LeftButton ) {
+        this->dragging   = true;
+        this->dragOrigin = event->position();
+    }
+}
+
+void PlotView::mouseMoveEvent( QMouseEvent* event ) {
+    if ( !this->dragging )
+        return;
+    QPointF delta    = event->position() - this->dragOrigin;
+    this->dragOrigin = event->position();
+    double dx        = delta.x() * this->viewport.pixelWidth();
+    double dy        = delta.y() * this->viewport.pixelHeight();
+    this->viewport.xmin -= dx;
+    this->viewport.xmax -= dx;
+    this->viewport.ymin += dy;
+    this->viewport.ymax += dy;
+    this->update();
+    this->requestSample();
+}
+
+void PlotView::mouseReleaseEvent( QMouseEvent* event ) {
+    if ( event->button() == Qt::LeftButton )
+        this->dragging = false;
+}
+
+void PlotView::wheelEvent( QWheelEvent* event ) {
+    // 以光标位置为中心缩放
+    double factor = std::pow( 0.999, event->angleDelta().y() );
+    double cx     = this->viewport.xmin + event->position().x() * this->viewport.pixelWidth();
+    double cy     = this->viewport.ymax - event->position().y() * this->viewport.pixelHeight();
+    this->viewport.xmin = cx + ( this->viewport.xmin - cx ) * factor;
+    this->viewport.xmax = cx + ( this->viewport.xmax - cx ) * factor;
+    this->viewport.ymin = cy + ( this->viewport.ymin - cy ) * factor;
+    this->viewport.ymax = cy + ( this->viewport.ymax - cy ) * factor;
+    this->update();
+    this->requestSample();
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <QPointF>
+#include <QString>
+#include <QThread>
+#include <QWidget>
+#include <memory>
+#include <simple_calculator/plot_sampler.hpp>
+#include <vector>
+
+Q_DECLARE_METATYPE( PlotViewport )
+Q_DECLARE_METATYPE( std::vector< PlotColumn > )
+
+// 在工作线程上运行 PlotSampler，采样缓存随表达式一起保留，平移缩放时只补充缺失的样本
+class PlotWorker : public QObject {
+    Q_OBJECT
+
+public:
+    explicit PlotWorker( QObject* parent = nullptr );
+    ~PlotWorker() override;
+
+public slots:
+    void setExpression( const QString& expr );
+    void sample( const PlotViewport& viewport );
+
+signals:
+    void sampled( const PlotViewport& viewport, const std::vector< PlotColumn >& columns );
+    void failed( const QString& message );
+
+private:
+    std::unique_ptr< PlotSampler > sampler;
+};
+
+// 函数图像面板：UI 线程只负责绘制已经抽取到像素列的结果，
+// 拖动和滚轮缩放时先把旧结果变换到新视口立即重绘，再异步请求新的采样
+class PlotView : public QWidget {
+    Q_OBJECT
+
+public:
+    explicit PlotView( QWidget* parent = nullptr );
+    ~PlotView() override;
+
+    void setExpression( const QString& expr );
+
+signals:
+    void expressionChanged( const QString& expr );
+    void sampleRequested( const PlotViewport& viewport );
+
+protected:
+    void paintEvent( QPaintEvent* event ) override;
+    void resizeEvent( QResizeEvent* event ) override;
+    void mousePressEvent( QMouseEvent* event ) override;
+    void mouseMoveEvent( QMouseEvent* event ) override;
+    void mouseReleaseEvent( QMouseEvent* event ) override;
+    void wheelEvent( QWheelEvent* event ) override;
+
+private slots:
+    void onSampled( const PlotViewport& sampledViewport, const std::vector< PlotColumn >& sampledColumns );
+    void onFailed( const QString& message );
+
+private:
+    QThread workerThread;
+    PlotWorker* worker;
+    QString expression;
+    QString error;
+
+    PlotViewport viewport;
+    // columns 是在 columnsViewport 下抽取的，绘制时变换到当前视口
+    PlotViewport columnsViewport;
+    std::vector< PlotColumn > columns;
+
+    // 同一时刻只有一个采样请求在途，其间的视口变化合并为一次
+    bool busy    = false;
+    bool pending = false;
+
+    bool dragging = false;
+    QPointF dragOrigin;
+
+    void requestSample();
+};
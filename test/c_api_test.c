@@ -0,0 +1,121 @@
+#include <simple_calculator/calculator_c.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// 以 C 编译，检查头文件保持 C 兼容，并覆盖跨语言调用的主要路径
+static int failures = 0;
+
+#define CHECK( condition )                                                           \
+    do {                                                                             \
+        if ( !( condition ) ) {                                                      \
+            fprintf( stderr, "%s:%d: CHECK(%s)\n", __FILE__, __LINE__, #condition ); \
+            ++failures;                                                              \
+        }                                                                            \
+    } while ( 0 )
+
+static sc_expression* compile( const char* source, const char* const* columns, size_t count ) {
+    sc_expression* expression = NULL;
+    char error[ 128 ];
+    sc_status status = sc_compile( source, strlen( source ), columns, count, &expression, error, sizeof error );
+    if ( status != SC_OK )
+        fprintf( stderr, "compile '%s' failed: %s\n", source, error );
+    return expression;
+}
+
+static void stridedBuffers( void ) {
+    const char* columns[]     = { "x", "y" };
+    sc_expression* expression = compile( "x*y+1", columns, 2 );
+    CHECK( expression != NULL );
+    CHECK( sc_column_count( expression ) == 2 );
+
+    // x 取自按行存储的表格的第二列，y 广播同一个值，结果写入交错缓冲区的偶数位置
+    double table[ 5 ][ 3 ];
+    for ( int i = 0; i < 5; ++i ) {
+        table[ i ][ 0 ] = -1;
+        table[ i ][ 1 ] = i;
+        table[ i ][ 2 ] = -1;
+    }
+    double y              = 10;
+    sc_column inputs[ 2 ] = { { &table[ 0 ][ 1 ], 3 }, { &y, 0 } };
+    double out[ 10 ]      = { 0 };
+    CHECK( sc_evaluate( expression, inputs, 2, 5, out, 2, NULL ) == SC_OK );
+    for ( int i = 0; i < 5; ++i ) {
+        CHECK( out[ 2 * i ] == i * 10 + 1 );
+        CHECK( out[ 2 * i + 1 ] == 0 );
+    }
+
+    CHECK( sc_evaluate( expression, inputs, 1, 5, out, 1, NULL ) == SC_INVALID_ARGUMENT );
+    sc_release( expression );
+}
+
+static void elementStatus( void ) {
+    const char* columns[]     = { "x" };
+    sc_expression* expression = compile( "sqrt(1/x)", columns, 1 );
+    CHECK( expression != NULL );
+
+    double xs[]         = { 4, 0, -1, 16 };
+    sc_column input     = { xs, 1 };
+    double out[ 4 ]     = { 0 };
+    uint8_t status[ 4 ] = { 0 };
+    CHECK( sc_evaluate( expression, &input, 1, 4, out, 1, status ) == SC_OK );
+    CHECK( out[ 0 ] == 0.5 && status[ 0 ] == SC_OK );
+    CHECK( status[ 1 ] == SC_DIVISION_BY_ZERO );
+    CHECK( status[ 2 ] == SC_SQRT_NEGATIVE && out[ 2 ] != out[ 2 ] );
+    CHECK( out[ 3 ] == 0.25 && status[ 3 ] == SC_OK );
+
+    // 没有错误码缓冲区时返回第一个错误，此前的行已经写入
+    out[ 0 ] = 0;
+    CHECK( sc_evaluate( expression, &input, 1, 4, out, 1, NULL ) == SC_DIVISION_BY_ZERO );
+    CHECK( out[ 0 ] == 0.5 );
+    CHECK( strcmp( sc_status_message( SC_DIVISION_BY_ZERO ), "Division by zero" ) == 0 );
+    sc_release( expression );
+}
+
+static void compileErrors( void ) {
+    const char* columns[]     = { "x" };
+    sc_expression* expression = (sc_expression*)1;
+    char error[ 16 ];
+    CHECK( sc_compile( "x+", 2, columns, 1, &expression, error, sizeof error ) == SC_PARSE_ERROR );
+    CHECK( expression == NULL && strlen( error ) > 0 && strlen( error ) < sizeof error );
+    CHECK( sc_compile( "x+z", 3, columns, 1, &expression, NULL, 0 ) == SC_PARSE_ERROR );
+    CHECK( sc_compile( "1", 1, NULL, 1, &expression, NULL, 0 ) == SC_INVALID_ARGUMENT );
+    // length 之后的字节不属于表达式
+    CHECK( sc_compile( "2*3+junk", 3, NULL, 0, &expression, NULL, 0 ) == SC_OK );
+    double out = 0;
+    CHECK( sc_evaluate( expression, NULL, 0, 1, &out, 1, NULL ) == SC_OK && out == 6 );
+    sc_release( expression );
+    sc_release( NULL );
+}
+
+// 超长的扁平表达式在解析时按 token 数拒绝
+static void longExpressions( void ) {
+    const size_t terms = 1000000;
+    char* source       = malloc( 2 * terms );
+    CHECK( source != NULL );
+    if ( !source )
+        return;
+    for ( size_t i = 0; i < terms; ++i ) {
+        source[ 2 * i ]     = '1';
+        source[ 2 * i + 1 ] = '+';
+    }
+    sc_expression* expression = NULL;
+    CHECK( sc_compile( source, 2 * terms - 1, NULL, 0, &expression, NULL, 0 ) == SC_PARSE_ERROR );
+    CHECK( expression == NULL );
+    CHECK( sc_compile( source, 2 * 1000 - 1, NULL, 0, &expression, NULL, 0 ) == SC_OK );
+    double out = 0;
+    CHECK( sc_evaluate( expression, NULL, 0, 1, &out, 1, NULL ) == SC_OK && out == 1000 );
+    sc_release( expression );
+    free( source );
+}
+
+int main( void ) {
+    CHECK( sc_abi_version() == SC_ABI_VERSION );
+    stridedBuffers();
+    elementStatus();
+    compileErrors();
+    longExpressions();
+    if ( failures )
+        fprintf( stderr, "%d check(s) failed\n", failures );
+    return failures ? 1 : 0;
+}
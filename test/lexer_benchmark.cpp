@@ -0,0 +1,69 @@
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <simple_calculator/calculator.hpp>
+#include <simple_calculator/token_buffer.hpp>
+#include <string>
+
+// 逐字符 Lexer 与批量 tokenize() 的吞吐量对比。
+// 用法：lexer_benchmark [输入大小(MB)，默认 32]
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    // 模拟机器生成的表达式：成千上万项的和
+    std::string generate( std::size_t bytes ) {
+        std::string input;
+        input.reserve( bytes + 64 );
+        for ( std::size_t i = 0; input.size() < bytes; ++i )
+            input += std::format( "{}*x_{} + sin(y{})/3.25 - ({}.5 ^ 2) +\n", i % 997, i % 31, i % 7, i % 113 );
+        input += "0";
+        return input;
+    }
+
+    template < typename F >
+    double best( F&& run ) {
+        double seconds = 1e300;
+        for ( int i = 0; i < 5; ++i ) {
+            auto start = Clock::now();
+            run();
+            seconds = std::min( seconds, std::chrono::duration< double >( Clock::now() - start ).count() );
+        }
+        return seconds;
+    }
+}  // namespace
+
+int main( int argc, char* argv[] ) {
+    std::size_t megabytes = argc > 1 ? std::strtoul( argv[ 1 ], nullptr, 10 ) : 32;
+    std::string input     = generate( megabytes << 20 );
+    auto size             = static_cast< double >( input.size() );
+
+    std::size_t streamingTokens = 0;
+    double streaming            = best( [ & ] {
+        Lexer lexer( input, LexMode::STREAMING );
+        streamingTokens = 0;
+        while ( lexer.nextToken().type != TokenType::END )
+            ++streamingTokens;
+    } );
+
+    std::size_t bulkTokens = 0;
+    double bulk            = best( [ & ] { bulkTokens = tokenize( input ).size(); } );
+
+    // 批量模式下 Parser 经由 Lexer 读取 token 缓冲区的开销
+    std::size_t bufferedTokens = 0;
+    double buffered            = best( [ & ] {
+        Lexer lexer( input, LexMode::BULK );
+        bufferedTokens = 0;
+        while ( lexer.nextToken().type != TokenType::END )
+            ++bufferedTokens;
+    } );
+
+    std::cout << std::format( "input: {:.1f} MB, {} tokens, tokenizer backend: {}\n", size / ( 1 << 20 ), bulkTokens,
+                              tokenizerBackend() );
+    std::cout << std::format( "streaming Lexer::nextToken   {:8.3f} s  {:6.2f} GB/s\n", streaming, size / streaming / 1e9 );
+    std::cout << std::format( "bulk tokenize()              {:8.3f} s  {:6.2f} GB/s  ({:.1f}x)\n", bulk,
+                              size / bulk / 1e9, streaming / bulk );
+    std::cout << std::format( "bulk Lexer::nextToken        {:8.3f} s  {:6.2f} GB/s  ({:.1f}x)\n", buffered,
+                              size / buffered / 1e9, streaming / buffered );
+    return streamingTokens == bulkTokens && bulkTokens == bufferedTokens ? 0 : 1;
+}
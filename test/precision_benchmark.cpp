@@ -0,0 +1,59 @@
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <simple_calculator/calculator.hpp>
+#include <simple_calculator/precision.hpp>
+#include <string>
+#include <vector>
+
+// 批量求值按 double 与按 float 的吞吐量对比，以及混合精度的误差估计和选择结果。
+// 用法：precision_benchmark [行数(百万)，默认 4]
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    template < typename F >
+    double best( F&& run ) {
+        double seconds = 1e300;
+        for ( int i = 0; i < 5; ++i ) {
+            auto start = Clock::now();
+            run();
+            seconds = std::min( seconds, std::chrono::duration< double >( Clock::now() - start ).count() );
+        }
+        return seconds;
+    }
+}  // namespace
+
+int main( int argc, char* argv[] ) {
+    std::size_t rows = ( argc > 1 ? std::strtoul( argv[ 1 ], nullptr, 10 ) : 4 ) * 1000000;
+    std::vector< double > xs( rows );
+    for ( std::size_t i = 0; i < rows; ++i )
+        xs[ i ] = 0.5 + static_cast< double >( i % 10007 ) / 97.0;
+    Column column{ xs.data() };
+    std::vector< double > wide( rows );
+    std::vector< float > narrow( rows );
+
+    for ( const std::string expr : { "x*2+1", "sin(x)*cos(x)+sin(2*x)", "ln(x+1)*lg(x+2)+ln(x+3)", "x^1.5+sqrt(x)^0.5",
+                                     "sin(x)^2+ln(x+1)*x^0.3", "(x+100000000)-100000000" } ) {
+        Lexer lexer( expr );
+        Parser parser( lexer, []( const std::string& name ) -> std::unique_ptr< ASTNode > {
+            return std::make_unique< VariableNode >( name, nullptr );
+        } );
+        auto ast     = parser.parse();
+        auto program = compileBatch( *ast, { "x" } );
+        BatchEvaluator evaluator( program, std::span( &column, 1 ) );
+        MixedPrecisionEvaluator mixed( program, std::span( &column, 1 ), rows );
+
+        double doubleSeconds = best( [ & ] { evaluator.run( 0, rows, wide.data() ); } );
+        double floatSeconds  = best( [ & ] { evaluator.run( 0, rows, narrow.data() ); } );
+        double mixedSeconds  = best( [ & ] { mixed.run( 0, rows, narrow.data() ); } );
+        auto perSecond       = [ rows ]( double seconds ) { return static_cast< double >( rows ) / seconds / 1e6; };
+        std::cout << std::format( "{:<24} double {:7.1f} M/s  float {:7.1f} M/s ({:.2f}x)  mixed {:7.1f} M/s  {} "
+                                  "(max rel. error {:.2e})\n",
+                                  expr, perSecond( doubleSeconds ), perSecond( floatSeconds ),
+                                  doubleSeconds / floatSeconds, perSecond( mixedSeconds ),
+                                  mixed.precision() == Precision::FLOAT32 ? "float32" : "float64",
+                                  mixed.estimate().maxRelativeError );
+    }
+    return 0;
+}
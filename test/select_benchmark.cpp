@@ -0,0 +1,111 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <random>
+#include <simple_calculator/calculator.hpp>
+#include <string>
+#include <vector>
+
+// if(...) 的两种求值策略随分支可预测性变化的对比：
+// 标量求值只计算选中的分支，但每行都有一次依赖数据的跳转；批量求值两个分支都算，再逐元素无分支地选择。
+// 条件列从全部相同、按块排序到完全随机，依次降低分支预测的命中率。
+// 最后对比 abs(x) 与过去常用的 sqrt((x)^2) 写法。
+// 用法：select_benchmark [行数(百万)，默认 1]
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    template < typename F >
+    double best( F&& run ) {
+        double seconds = 1e300;
+        for ( int i = 0; i < 5; ++i ) {
+            auto start = Clock::now();
+            run();
+            seconds = std::min( seconds, std::chrono::duration< double >( Clock::now() - start ).count() );
+        }
+        return seconds;
+    }
+
+    struct Pattern {
+        std::string name;
+        std::vector< double > condition;
+    };
+
+    // 取值为 1 的比例为 share 的条件列；sorted 时所有 1 排在前面，分支几乎总能被预测
+    Pattern pattern( std::string name, std::size_t rows, double share, bool sorted, std::mt19937& random ) {
+        std::bernoulli_distribution pick( share );
+        std::vector< double > condition( rows );
+        for ( double& c : condition )
+            c = pick( random ) ? 1 : 0;
+        if ( sorted )
+            std::sort( condition.begin(), condition.end(), std::greater<>() );
+        return { std::move( name ), std::move( condition ) };
+    }
+}  // namespace
+
+int main( int argc, char* argv[] ) {
+    std::size_t rows = ( argc > 1 ? std::strtoul( argv[ 1 ], nullptr, 10 ) : 1 ) * 1000000;
+    std::mt19937 random( 7 );
+    std::vector< double > xs( rows );
+    for ( std::size_t i = 0; i < rows; ++i )
+        xs[ i ] = 0.5 + static_cast< double >( i % 10007 ) / 97.0;
+
+    std::vector< Pattern > patterns;
+    patterns.push_back( pattern( "constant", rows, 1.0, false, random ) );
+    patterns.push_back( pattern( "sorted 50%", rows, 0.5, true, random ) );
+    patterns.push_back( pattern( "random 99%", rows, 0.99, false, random ) );
+    patterns.push_back( pattern( "random 90%", rows, 0.9, false, random ) );
+    patterns.push_back( pattern( "random 50%", rows, 0.5, false, random ) );
+
+    double x = 0;
+    double c = 0;
+    auto resolver = [ & ]( const std::string& name ) -> std::unique_ptr< ASTNode > {
+        return std::make_unique< VariableNode >( name, name == "c" ? &c : &x );
+    };
+    auto parse = [ & ]( const std::string& expr ) {
+        Lexer lexer( expr );
+        Parser parser( lexer, resolver );
+        return parser.parse();
+    };
+    std::vector< double > out( rows );
+    auto perSecond = [ rows ]( double seconds ) { return static_cast< double >( rows ) / seconds / 1e6; };
+
+    for ( const std::string expr : { "if(c > 0, x + 1, x - 1)", "if(c > 0, ln(x) * sin(x), sqrt(x) + x)" } ) {
+        auto ast     = parse( expr );
+        auto program = compileBatch( *ast, { "x", "c" } );
+        std::cout << expr << "\n";
+        for ( const Pattern& p : patterns ) {
+            Column columns[]{ { xs.data() }, { p.condition.data() } };
+            BatchEvaluator evaluator( program, columns );
+            double scalarSeconds = best( [ & ] {
+                for ( std::size_t i = 0; i < rows; ++i ) {
+                    x        = xs[ i ];
+                    c        = p.condition[ i ];
+                    out[ i ] = ast->evaluate();
+                }
+            } );
+            double batchSeconds = best( [ & ] { evaluator.run( 0, rows, out.data() ); } );
+            std::cout << std::format( "  {:<12} scalar lazy {:7.1f} M/s  batch select {:7.1f} M/s ({:.2f}x)\n", p.name,
+                                      perSecond( scalarSeconds ), perSecond( batchSeconds ),
+                                      scalarSeconds / batchSeconds );
+        }
+    }
+
+    for ( const std::string expr : { "abs(x - 50)", "sqrt((x - 50)^2)" } ) {
+        auto ast     = parse( expr );
+        auto program = compileBatch( *ast, { "x" } );
+        Column column{ xs.data() };
+        BatchEvaluator evaluator( program, std::span( &column, 1 ) );
+        double scalarSeconds = best( [ & ] {
+            for ( std::size_t i = 0; i < rows; ++i ) {
+                x        = xs[ i ];
+                out[ i ] = ast->evaluate();
+            }
+        } );
+        double batchSeconds = best( [ & ] { evaluator.run( 0, rows, out.data() ); } );
+        std::cout << std::format( "{:<24} scalar {:7.1f} M/s  batch {:7.1f} M/s\n", expr, perSecond( scalarSeconds ),
+                                  perSecond( batchSeconds ) );
+    }
+    return 0;
+}
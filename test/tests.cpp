@@ -1,10 +1,29 @@
 #include <gtest/gtest.h>
 
+#include <chrono>
 #include <cmath>
+#include <filesystem>
+#include <fstream>
 #include <map>
+#include <numbers>
+#include <numeric>
+#include <random>
+#include <optional>
+#include <sstream>
+#include <simple_calculator/budget.hpp>
+#include <simple_calculator/bundle.hpp>
 #include <simple_calculator/calculator.hpp>
+#include <simple_calculator/formula_graph.hpp>
+#include <simple_calculator/ingest.hpp>
+#include <simple_calculator/instrumentation.hpp>
+#include <simple_calculator/numeric.hpp>
+#include <simple_calculator/parallel.hpp>
+#include <simple_calculator/plot_sampler.hpp>
+#include <simple_calculator/precision.hpp>
+#include <simple_calculator/token_buffer.hpp>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 // 测试计算器功能
 TEST( CalculatorTest, BasicOperator ) {
@@ -280,3 +299,845 @@ TEST( CalculatorTest, InvalidInput ) {
         },
         std::runtime_error );
 }
+
+TEST( CalculatorTest, UnknownIdentifier ) {
+    // 未提供 Resolver 时，未知标识符仍然报错
+    EXPECT_THROW(
+        {
+            Lexer lexer( "1+foo" );
+            Parser parser( lexer );
+            parser.parse();
+        },
+        std::runtime_error );
+}
+
+// 模糊测试发现的输入：应当快速返回结果或抛出 runtime_error，而不是崩溃或长时间运行
+TEST( CalculatorTest, PathologicalInput ) {
+    auto evaluate = []( const std::string& input ) {
+        Lexer lexer( input );
+        Parser parser( lexer );
+        return parser.parse()->evaluate();
+    };
+    EXPECT_TRUE( std::isinf( evaluate( "1000000000!" ) ) );
+    EXPECT_DOUBLE_EQ( evaluate( std::string( 400, '(' ) + "1" + std::string( 400, ')' ) ), 1 );
+    EXPECT_THROW( evaluate( std::string( 4000, '(' ) + "1" + std::string( 4000, ')' ) ), std::runtime_error );
+    EXPECT_THROW( evaluate( "." ), std::runtime_error );
+    EXPECT_THROW( evaluate( "1" + std::string( 400, '0' ) ), std::runtime_error );
+    // NaN 不是整数，不能进入阶乘的循环
+    EXPECT_THROW( evaluate( "((0-1)^0.5)!" ), std::runtime_error );
+    Lexer lexer( "((0-1)^0.5)!" );
+    auto ast     = Parser( lexer ).parse();
+    auto program = compileBatch( *ast );
+    double value = 0;
+    EvalStatus status{};
+    BatchEvaluator( program, {} ).run( 0, 1, &value, &status );
+    EXPECT_EQ( status, EvalStatus::FACTORIAL_NON_INTEGER );
+}
+
+// 批量词法分析必须与逐字符 Lexer 给出完全相同的 token 序列和错误
+TEST( BulkLexerTest, MatchesStreamingLexer ) {
+    auto lex = []( const std::string& input, LexMode mode ) {
+        std::vector< std::string > tokens;
+        Lexer lexer( input, mode );
+        try {
+            for ( Token token = lexer.nextToken(); token.type != TokenType::END; token = lexer.nextToken() )
+                tokens.push_back( std::format( "{}:{}:{}", static_cast< int >( token.type ), token.value, token.name ) );
+        }
+        catch ( const std::runtime_error& e ) {
+            tokens.emplace_back( e.what() );
+        }
+        return tokens;
+    };
+    std::vector< std::string > inputs{
+        "1 + 2*sqrt(x_1)\t- 3.5!", "a = .5; b = a^2 % 3", "dot(x, y) / mean(x)", "1..2", "..", "1 $ 2", "sinx + pie",
+        "if(x<=1, abs(x), clamp(x,0,2)) != 3!==4 >= 5 > 6 < 7=", "<<==>!>=",
+        std::string( 100, 'a' ) + "+" + std::string( 80, '7' ) + "." + std::string( 30, '1' ), "1" + std::string( 400, '0' ),
+    };
+    // 随机输入，覆盖跨 64 字节块边界的 token
+    std::mt19937 random( 42 );
+    const std::string alphabet = "0123456789.abcxyz_+-*/^%!(),;=<> \t\n";
+    for ( int i = 0; i < 200; ++i ) {
+        std::string input( 1 + random() % 300, ' ' );
+        for ( char& c : input )
+            c = alphabet[ random() % alphabet.size() ];
+        inputs.push_back( input );
+    }
+    for ( const auto& input : inputs )
+        EXPECT_EQ( lex( input, LexMode::BULK ), lex( input, LexMode::STREAMING ) ) << input;
+
+    // 大输入自动使用批量模式，解析结果不变
+    std::string terms = "1";
+    for ( int i = 0; i < 5000; ++i )
+        terms += " + x*2";
+    double x = 0.5;
+    Lexer lexer( terms );
+    Parser parser( lexer, [ & ]( const std::string& name ) { return std::make_unique< VariableNode >( name, &x ); } );
+    EXPECT_DOUBLE_EQ( parser.parse()->evaluate(), 5001 );
+    EXPECT_NE( std::string( tokenizerBackend() ), "" );
+}
+
+TEST( FormulaGraphTest, RecalculatesOnlyDownstream ) {
+    FormulaGraph graph( 2 );
+    graph.setInput( "a", 1 );
+    graph.setInput( "b", 2 );
+    graph.define( "subtotal", "a+b" );
+    graph.define( "twice", "subtotal*2" );
+    graph.define( "other", "b^2" );
+    graph.recalculate();
+    EXPECT_EQ( graph.value( "twice" ), 6 );
+    EXPECT_EQ( graph.value( "other" ), 4 );
+    EXPECT_EQ( graph.stats().lastRecomputed, 3 );
+    EXPECT_EQ( graph.stats().lastWaves, 2 );
+
+    // 只有 subtotal 和 twice 依赖 a
+    graph.setInput( "a", 10 );
+    EXPECT_TRUE( graph.isDirty( "twice" ) );
+    EXPECT_FALSE( graph.isDirty( "other" ) );
+    graph.recalculate();
+    EXPECT_EQ( graph.value( "twice" ), 24 );
+    EXPECT_EQ( graph.stats().lastRecomputed, 2 );
+    EXPECT_EQ( graph.stats().totalRecomputed, 5 );
+}
+
+TEST( FormulaGraphTest, DetectsCycles ) {
+    FormulaGraph graph( 0 );
+    graph.define( "a", "b+1" );
+    graph.define( "b", "c+1" );
+    EXPECT_THROW( graph.define( "c", "a+1" ), std::runtime_error );
+    EXPECT_THROW( graph.define( "d", "d+1" ), std::runtime_error );
+    // 失败的定义不会改变图
+    graph.setInput( "c", 1 );
+    graph.recalculate();
+    EXPECT_EQ( graph.value( "a" ), 3 );
+}
+
+TEST( FormulaGraphTest, PropagatesErrors ) {
+    FormulaGraph graph( 0 );
+    graph.define( "ratio", "1/x" );
+    graph.define( "scaled", "ratio*2" );
+    graph.recalculate();
+    EXPECT_THROW( static_cast< void >( graph.value( "scaled" ) ), std::runtime_error );
+    graph.setInput( "x", 0 );
+    graph.recalculate();
+    EXPECT_THROW( static_cast< void >( graph.value( "ratio" ) ), std::runtime_error );
+    graph.setInput( "x", 4 );
+    graph.recalculate();
+    EXPECT_EQ( graph.value( "scaled" ), 0.5 );
+}
+
+TEST( FormulaGraphTest, ParallelWideGraph ) {
+    FormulaGraph graph( 4 );
+    graph.setInput( "base", 1 );
+    for ( int i = 0; i < 1000; ++i )
+        graph.define( "f" + std::to_string( i ), "base*" + std::to_string( i ) );
+    graph.define( "total", "f10+f999" );
+    graph.recalculate();
+    EXPECT_EQ( graph.stats().lastRecomputed, 1001 );
+    graph.setInput( "base", 2 );
+    graph.recalculate();
+    EXPECT_EQ( graph.value( "total" ), 2018 );
+}
+
+// 两次重算之间多次重新定义同一个公式，只能重算一次，下游仍按依赖分层
+TEST( FormulaGraphTest, RedefineBeforeRecalculate ) {
+    FormulaGraph graph( 4 );
+    graph.define( "a", "1" );
+    graph.define( "c", "a+1" );
+    graph.define( "b", "c*2" );
+    graph.recalculate();
+    EXPECT_EQ( graph.value( "b" ), 4 );
+    graph.define( "a", "2" );
+    graph.define( "a", "3" );
+    graph.recalculate();
+    EXPECT_EQ( graph.stats().lastWaves, 3 );
+    EXPECT_EQ( graph.stats().lastRecomputed, 3 );
+    EXPECT_EQ( graph.value( "c" ), 4 );
+    EXPECT_EQ( graph.value( "b" ), 8 );
+}
+
+TEST( ScriptTest, LetBindings ) {
+    Script script;
+    script.compile( "a = sqrt(2); b = a*a + a; b / a" );
+    EXPECT_NEAR( script.run(), ( 2 + sqrt( 2 ) ) / sqrt( 2 ), 1e-12 );
+    EXPECT_EQ( script.slotCount(), 2 );
+    EXPECT_NEAR( script.get( *script.slotOf( "b" ) ), 2 + sqrt( 2 ), 1e-12 );
+
+    // 允许末尾的分号和重新赋值
+    script.compile( "x = 1; x = x + 1; x * 10;" );
+    EXPECT_EQ( script.run(), 20 );
+    EXPECT_FALSE( script.slotOf( "a" ).has_value() );
+}
+
+TEST( ScriptTest, PredefinedSlots ) {
+    Script script( { "Ans" } );
+    auto ans = *script.slotOf( "Ans" );
+    script.compile( "Ans*2" );
+    script.set( ans, 21 );
+    EXPECT_EQ( script.run(), 42 );
+    // 重新编译后预定义寄存器的值保留
+    script.compile( "Ans+1" );
+    EXPECT_EQ( script.run(), 22 );
+}
+
+TEST( ScriptTest, InvalidScripts ) {
+    Script script;
+    // 使用前必须先赋值
+    EXPECT_THROW( script.compile( "a = a + 1" ), std::runtime_error );
+    EXPECT_THROW( script.compile( "b * 2; b = 1" ), std::runtime_error );
+    EXPECT_THROW( script.compile( "1 = 2" ), std::runtime_error );
+    EXPECT_THROW( script.compile( "a = 1 2" ), std::runtime_error );
+    // 单表达式解析不接受语句语法
+    EXPECT_THROW(
+        {
+            Lexer lexer( "a = 1" );
+            Parser parser( lexer );
+            parser.parse();
+        },
+        std::runtime_error );
+}
+
+TEST( AggregateTest, BasicReductions ) {
+    std::vector< double > xs{ 1, 2, 3, 4 };
+    std::vector< double > ys{ 2, 0.5, 1, -1 };
+    ArrayBindings arrays;
+    arrays.bind( "x", xs );
+    arrays.bind( "y", ys );
+    // clang-format off
+    auto parses = std::map< std::string, double >{
+        { "sum(x)", 10 },
+        { "sum(x^2)", 30 },
+        { "mean(x)", 2.5 },
+        { "min(x*y)", -4 },
+        { "max(x*y)", 3 },
+        { "dot(x, y)", 2 },
+        { "sum(x - mean(x))", 0 },
+        { "1 + sum(2*x) / 4", 6 },
+    };
+    // clang-format on
+    for ( auto& e : parses ) {
+        Lexer lexer( e.first );
+        Parser parser( lexer, arrays.resolver() );
+        auto ast = parser.parse();
+        EXPECT_DOUBLE_EQ( ast->evaluate(), e.second ) << e.first;
+    }
+}
+
+TEST( AggregateTest, RebindAndErrors ) {
+    std::vector< double > xs{ 1, 2, 3 };
+    std::vector< double > shorter{ 1, 2 };
+    ArrayBindings arrays;
+    arrays.bind( "x", xs );
+    arrays.bind( "y", shorter );
+
+    Lexer lexer( "sum(x)" );
+    Parser parser( lexer, arrays.resolver() );
+    auto ast = parser.parse();
+    EXPECT_EQ( ast->evaluate(), 6 );
+    arrays.bind( "x", shorter );
+    EXPECT_EQ( ast->evaluate(), 3 );
+
+    auto evaluate = [ &arrays ]( const std::string& expr ) {
+        Lexer l( expr );
+        Parser p( l, arrays.resolver() );
+        return p.parse()->evaluate();
+    };
+    arrays.bind( "x", xs );
+    EXPECT_THROW( evaluate( "x + 1" ), std::runtime_error );
+    EXPECT_THROW( evaluate( "sum(3)" ), std::runtime_error );
+    EXPECT_THROW( evaluate( "dot(x, y)" ), std::runtime_error );
+    EXPECT_THROW( evaluate( "sum(1/(x-2))" ), std::runtime_error );
+    EXPECT_THROW( evaluate( "sum(sqrt(x-3))" ), std::runtime_error );
+}
+
+TEST( AggregateTest, LargeArrayIsCompensatedAndDeterministic ) {
+    // 超过并行阈值，且 0.1 无法精确表示，朴素求和会累积明显误差
+    std::vector< double > xs( 1 << 20, 0.1 );
+    ArrayBindings arrays;
+    arrays.bind( "x", xs );
+    Lexer lexer( "sum(x)" );
+    Parser parser( lexer, arrays.resolver() );
+    auto ast     = parser.parse();
+    double first = ast->evaluate();
+    EXPECT_NEAR( first, 0.1 * static_cast< double >( xs.size() ), 1e-9 );
+    for ( int i = 0; i < 5; ++i )
+        EXPECT_EQ( ast->evaluate(), first );
+
+    std::iota( xs.begin(), xs.end(), 0.0 );
+    Lexer meanLexer( "mean(x) + max(x) - min(x)" );
+    Parser meanParser( meanLexer, arrays.resolver() );
+    auto mean = meanParser.parse();
+    double n  = static_cast< double >( xs.size() );
+    EXPECT_DOUBLE_EQ( mean->evaluate(), ( n - 1 ) / 2 + ( n - 1 ) );
+}
+
+TEST( BudgetTest, StaticCostModel ) {
+    auto cost = []( const std::string& input, const Parser::Resolver& resolver = {} ) {
+        Lexer lexer( input );
+        Parser parser( lexer, resolver );
+        return estimateCost( *parser.parse() );
+    };
+    ExpressionCost simple = cost( "1+2*3" );
+    EXPECT_EQ( simple.nodes, 5 );
+    EXPECT_EQ( simple.depth, 3 );
+    EXPECT_DOUBLE_EQ( simple.cost, 5 );
+    EXPECT_DOUBLE_EQ( cost( "5!" ).factorialIterations, 5 );
+    EXPECT_DOUBLE_EQ( cost( "(2+3)!" ).factorialIterations, cost_weight::MAX_FACTORIAL_ITERATIONS );
+    EXPECT_DOUBLE_EQ( cost( "1000000000!" ).factorialIterations, cost_weight::MAX_FACTORIAL_ITERATIONS );
+
+    // 聚合函数的逐元素代价乘以数组长度，内部嵌套的聚合只算一次
+    std::vector< double > data( 1000, 1.0 );
+    ArrayBindings arrays;
+    arrays.bind( "x", data );
+    ExpressionCost aggregate = cost( "sum(sin(x) - mean(x))", arrays.resolver() );
+    EXPECT_DOUBLE_EQ( aggregate.transcendentalCalls, 1000 );
+    EXPECT_DOUBLE_EQ( aggregate.cost, 1000 * ( 1 + cost_weight::TRANSCENDENTAL + 1 ) + 1000 );
+    EXPECT_EQ( aggregate.depth, 4 );
+}
+
+TEST( BudgetTest, RejectsOverBudgetRequests ) {
+    auto code = []( const std::string& input, const ResourceBudget& budget,
+                    const Parser::Resolver& resolver = {} ) -> std::optional< BudgetError > {
+        try {
+            static_cast< void >( evaluateWithBudget( input, budget, resolver ) );
+        }
+        catch ( const BudgetExceeded& e ) {
+            return e.code();
+        }
+        return std::nullopt;
+    };
+    ResourceBudget budget;
+    EXPECT_DOUBLE_EQ( evaluateWithBudget( "2*(3+4)", budget ), 14 );
+    EXPECT_EQ( code( std::string( budget.maxInputBytes + 1, '1' ), budget ), BudgetError::INPUT_TOO_LARGE );
+    std::string terms = "1";
+    for ( int i = 0; i < 600; ++i )
+        terms += "+1";
+    EXPECT_EQ( code( terms, ResourceBudget{ .maxTokens = 100 } ), BudgetError::TOO_MANY_TOKENS );
+    EXPECT_EQ( code( std::string( 300, '-' ) + "1", budget ), BudgetError::TOO_DEEP );
+    // 深度限制针对嵌套而不是长度：左结合的长链条只算一层
+    std::string flat = "1";
+    for ( int i = 1; i < 1000; ++i )
+        flat += i % 2 ? "+2*3" : "-1";
+    EXPECT_DOUBLE_EQ( evaluateWithBudget( flat, budget ), 1 + 500 * 6 - 499 );
+    std::string minimum = "min(3";
+    for ( int i = 0; i < 500; ++i )
+        minimum += ", 2";
+    EXPECT_DOUBLE_EQ( evaluateWithBudget( minimum + ", 1)", budget ), 1 );
+    // 链条迭代展开，调用栈不随长度增长：放宽 token 预算后，二十万项的扁平表达式同样能估计、求值和批量编译
+    std::string huge = "1";
+    for ( int i = 1; i < 200000; ++i )
+        huge += "+1";
+    ResourceBudget wide;
+    wide.maxInputBytes = huge.size();
+    wide.maxTokens     = huge.size() + 1;
+    wide.deadline      = std::chrono::seconds( 30 );
+    EXPECT_DOUBLE_EQ( evaluateWithBudget( huge, wide ), 200000 );
+    {
+        Lexer lexer( huge );
+        auto ast     = Parser( lexer ).parse();
+        auto program = compileBatch( *ast );
+        double value = 0;
+        BatchEvaluator( program, {} ).run( 0, 1, &value );
+        EXPECT_DOUBLE_EQ( value, 200000 );
+    }
+    EXPECT_EQ( code( std::string( 5000, '(' ) + "1" + std::string( 5000, ')' ), budget ), BudgetError::TOO_DEEP );
+
+    std::vector< double > data( 1000000, 0.5 );
+    ArrayBindings arrays;
+    arrays.bind( "x", data );
+    EXPECT_EQ( code( "sum(sin(x)*cos(x))", budget, arrays.resolver() ), BudgetError::TOO_EXPENSIVE );
+    // 代价预算放宽后由求值过程中的时限检查终止
+    ResourceBudget unlimited{ .maxCost = 1e12, .deadline = std::chrono::milliseconds( 0 ) };
+    EXPECT_EQ( code( "sum(sin(x)*cos(x))", unlimited, arrays.resolver() ), BudgetError::DEADLINE_EXCEEDED );
+    // 超出预算仍然是 runtime_error
+    EXPECT_THROW( static_cast< void >( evaluateWithBudget( "1000!", ResourceBudget{ .maxCost = 10 } ) ),
+                  std::runtime_error );
+}
+
+TEST( BatchTest, MatchesScalarEvaluation ) {
+    std::vector< double > xs( 1000 );
+    std::iota( xs.begin(), xs.end(), 1.0 );
+    double x = 0;
+    for ( const std::string expr : { "x*2+1", "sin(x)^2+cos(x)^2", "sqrt(x)%3", "ln(x)-lg(x)", "(x%5)!", "-x/7" } ) {
+        Lexer lexer( expr );
+        Parser parser( lexer, [ &x ]( const std::string& name ) -> std::unique_ptr< ASTNode > {
+            return name == "x" ? std::make_unique< VariableNode >( name, &x ) : nullptr;
+        } );
+        auto ast     = parser.parse();
+        auto program = compileBatch( *ast, { "x" } );
+        Column column{ xs.data() };
+        BatchEvaluator evaluator( program, std::span( &column, 1 ) );
+        std::vector< double > out( xs.size() );
+        evaluator.run( 0, xs.size(), out.data() );
+        for ( std::size_t i = 0; i < xs.size(); ++i ) {
+            x = xs[ i ];
+            EXPECT_DOUBLE_EQ( out[ i ], ast->evaluate() ) << expr << " at " << x;
+        }
+    }
+}
+
+TEST( BatchTest, ReportsPerElementStatus ) {
+    std::vector< double > xs{ 1, 0, -1 };
+    double x = 0;
+    Lexer lexer( "sqrt(1/x)" );
+    Parser parser( lexer, [ &x ]( const std::string& name ) -> std::unique_ptr< ASTNode > {
+        return std::make_unique< VariableNode >( name, &x );
+    } );
+    auto ast     = parser.parse();
+    auto program = compileBatch( *ast, { "x" } );
+    Column column{ xs.data() };
+    BatchEvaluator evaluator( program, std::span( &column, 1 ) );
+    std::vector< double > out( 3 );
+    std::vector< EvalStatus > status( 3 );
+    evaluator.run( 0, 3, out.data(), status.data() );
+    EXPECT_EQ( out[ 0 ], 1 );
+    EXPECT_EQ( status[ 0 ], EvalStatus::OK );
+    EXPECT_EQ( status[ 1 ], EvalStatus::DIVISION_BY_ZERO );
+    EXPECT_EQ( status[ 2 ], EvalStatus::SQRT_NEGATIVE );
+    EXPECT_TRUE( std::isnan( out[ 2 ] ) );
+    EXPECT_THROW( evaluator.run( 0, 3, out.data() ), std::runtime_error );
+}
+
+// 标量求值只计算选中的分支；批量求值两个分支都算，但未选中分支的错误被丢弃，两者结果和状态一致
+TEST( ConditionalTest, LazyScalarAndMaskedBatch ) {
+    double x = 0;
+    std::vector< double > a{ -1, 2 };
+    ArrayBindings arrays;
+    arrays.bind( "a", a );
+    auto resolver = [ &x, arrayResolver = arrays.resolver() ]( const std::string& name ) -> std::unique_ptr< ASTNode > {
+        return name == "x" ? std::make_unique< VariableNode >( name, &x ) : arrayResolver( name );
+    };
+    auto parse = [ & ]( const std::string& expr ) {
+        Lexer lexer( expr );
+        Parser parser( lexer, resolver );
+        return parser.parse();
+    };
+    auto evaluate = [ & ]( const std::string& expr, double at ) {
+        x = at;
+        return parse( expr )->evaluate();
+    };
+
+    EXPECT_EQ( evaluate( "if(x>0, ln(x), 0)", -1 ), 0 );
+    EXPECT_DOUBLE_EQ( evaluate( "if(x>0, ln(x), 0)", std::numbers::e ), 1 );
+    EXPECT_THROW( static_cast< void >( evaluate( "if(x<0, ln(x), 0)", -1 ) ), std::runtime_error );
+    EXPECT_EQ( evaluate( "(x < 2) + (x <= 2) + (x > 2) + (x >= 2) + (x == 2) * 10 + (x != 2) * 100", 2 ), 12 );
+    EXPECT_EQ( evaluate( "1 + 2 < 4", 0 ), 1 );
+    EXPECT_THROW( static_cast< void >( evaluate( "3!==6", 0 ) ), std::runtime_error );  // 词法上是 3 != = 6
+    EXPECT_EQ( evaluate( "3! == 6", 0 ), 1 );
+    EXPECT_EQ( evaluate( "abs(x) + clamp(x, 0, 2) + clamp(5, 0, 2)", -3 ), 5 );
+    EXPECT_EQ( evaluate( "min(3, x, 2) + max(3, x, 2) * 10", 1 ), 31 );
+    EXPECT_EQ( evaluate( "(x < 2) < 3", 1 ), 1 );
+    EXPECT_THROW( static_cast< void >( evaluate( "x < 2 < 3", 1 ) ), std::runtime_error );
+    EXPECT_THROW( static_cast< void >( evaluate( "if(x, 1)", 1 ) ), std::runtime_error );
+    EXPECT_THROW( static_cast< void >( evaluate( "clamp(x, 1)", 1 ) ), std::runtime_error );
+
+    std::vector< double > xs{ -2, -1, 0, 0.5, 1, 3, std::nan( "" ) };
+    Column column{ xs.data() };
+    for ( const std::string expr :
+          { "if(x>0, ln(x), 0)", "if(x<0, sqrt(-x), sqrt(x))", "if(x, 1/x, 0)", "if(1/x > 0, 1, 2)",
+            "if(x<1, ln(x), x)", "clamp(x, -1, 1) * abs(x)", "max(x, 0, x^2) - min(x, 1)", "if(x>=0, (x*2)!, -x)",
+            // 标量子表达式出错时，只有选中它的行报告错误
+            "if(x > 0, x, sum(ln(a)))",
+            // 两个操作数都出错时报告左操作数的错误
+            "ln(x)/(x-x)", "if(x<0, ln(x)/(x-x), 0)", "sqrt(x) % (x-x)", "sqrt(x) + 1/(x-x)" } ) {
+        auto ast     = parse( expr );
+        auto program = compileBatch( *ast, { "x" } );
+        BatchEvaluator evaluator( program, std::span( &column, 1 ) );
+        std::vector< double > out( xs.size() );
+        std::vector< float > narrow( xs.size() );
+        std::vector< EvalStatus > status( xs.size() );
+        std::vector< EvalStatus > narrowStatus( xs.size() );
+        evaluator.run( 0, xs.size(), out.data(), status.data() );
+        evaluator.run( 0, xs.size(), narrow.data(), narrowStatus.data() );
+        EXPECT_EQ( status, narrowStatus ) << expr;
+        for ( std::size_t i = 0; i < xs.size(); ++i ) {
+            x = xs[ i ];
+            std::optional< double > scalar;
+            EvalStatus scalarStatus = EvalStatus::OK;
+            try {
+                scalar = ast->evaluate();
+            }
+            catch ( const EvaluationError& e ) {
+                scalarStatus = e.status();
+            }
+            EXPECT_EQ( status[ i ], scalarStatus ) << expr << " at " << x;
+            if ( scalar && !std::isnan( *scalar ) ) {
+                EXPECT_DOUBLE_EQ( out[ i ], *scalar ) << expr << " at " << x;
+            }
+        }
+    }
+}
+
+TEST( PrecisionTest, FloatPathAndFallback ) {
+    std::vector< double > xs( 1000 );
+    for ( std::size_t i = 0; i < xs.size(); ++i )
+        xs[ i ] = 0.25 + static_cast< double >( i ) / 10;
+    Column column{ xs.data() };
+    auto mixed = [ & ]( const std::string& expr, Precision expected ) {
+        Lexer lexer( expr );
+        Parser parser( lexer, []( const std::string& name ) -> std::unique_ptr< ASTNode > {
+            return std::make_unique< VariableNode >( name, nullptr );
+        } );
+        auto ast     = parser.parse();
+        auto program = compileBatch( *ast, { "x" } );
+        MixedPrecisionEvaluator evaluator( program, std::span( &column, 1 ), xs.size() );
+        EXPECT_EQ( evaluator.precision(), expected ) << expr;
+        EXPECT_EQ( evaluator.estimate().samples, 256 ) << expr;
+
+        std::vector< double > wide( xs.size() );
+        std::vector< float > narrow( xs.size() );
+        BatchEvaluator( program, std::span( &column, 1 ) ).run( 0, xs.size(), wide.data() );
+        evaluator.run( 0, xs.size(), narrow.data() );
+        // 选定的精度在所有行上都满足约 6 位有效数字
+        for ( std::size_t i = 0; i < xs.size(); ++i )
+            EXPECT_NEAR( narrow[ i ], wide[ i ], 1e-5 * std::abs( wide[ i ] ) ) << expr << " at " << xs[ i ];
+    };
+    mixed( "ln(x+1)*x^0.5+sqrt(x)", Precision::FLOAT32 );
+    mixed( "lg(x+2)/(x^2+1)*cos(x/1000)", Precision::FLOAT32 );
+    // float 中 x + 10^8 丢掉了 x 的大部分有效位；sin 在零点附近的相对误差被放大；中间结果 x^40 超出 float 的范围
+    mixed( "(x+100000000)-100000000", Precision::FLOAT64 );
+    mixed( "sin(x)*ln(x+1)", Precision::FLOAT64 );
+    mixed( "x^40/x^39", Precision::FLOAT64 );
+
+    // 错误状态与 double 路径一致
+    std::vector< double > ys{ 4, 0, -1 };
+    Column ycolumn{ ys.data() };
+    Lexer lexer( "sqrt(1/y)" );
+    Parser parser( lexer, []( const std::string& name ) -> std::unique_ptr< ASTNode > {
+        return std::make_unique< VariableNode >( name, nullptr );
+    } );
+    auto ast     = parser.parse();
+    auto program = compileBatch( *ast, { "y" } );
+    std::vector< float > out( 3 );
+    std::vector< EvalStatus > status( 3 );
+    BatchEvaluator evaluator( program, std::span( &ycolumn, 1 ) );
+    evaluator.run( 0, 3, out.data(), status.data() );
+    EXPECT_EQ( out[ 0 ], 0.5F );
+    EXPECT_EQ( status[ 1 ], EvalStatus::DIVISION_BY_ZERO );
+    EXPECT_EQ( status[ 2 ], EvalStatus::SQRT_NEGATIVE );
+    EXPECT_THROW( evaluator.run( 0, 3, out.data() ), std::runtime_error );
+
+    auto scalar = []( const std::string& expr ) {
+        Lexer scalarLexer( expr );
+        Parser scalarParser( scalarLexer );
+        return evaluateFloat( *scalarParser.parse() );
+    };
+    EXPECT_FLOAT_EQ( scalar( "sin(pi/6)*4+2^0.5" ), 2 + std::sqrt( 2.0F ) );
+    EXPECT_FLOAT_EQ( scalar( "34!" ), 2.9523279e38F );
+    EXPECT_TRUE( std::isinf( scalar( "35!" ) ) );
+    EXPECT_THROW( static_cast< void >( scalar( "1/(2-2)" ) ), std::runtime_error );
+}
+
+TEST( ParallelTest, MatchesSequentialEvaluation ) {
+    double x = 0.1;
+    auto parse = [ &x ]( const std::string& expr ) {
+        Lexer lexer( expr );
+        Parser parser( lexer, [ &x ]( const std::string& name ) -> std::unique_ptr< ASTNode > {
+            return std::make_unique< VariableNode >( name, &x );
+        } );
+        return parser.parse();
+    };
+    ThreadPool serial( 0 );
+    ThreadPool workers( 4 );
+
+    std::string chain = "1";
+    for ( int i = 1; i < 2000; ++i )
+        chain += ( i % 3 ? "+x*" : "-sin(x)/" ) + std::to_string( i % 17 + 1 );
+    for ( const std::string& expr : { std::string( "2^3^2-8/4/2%3" ), std::string( "-(1+x)*(2-x)/(3+x)" ), chain } ) {
+        auto ast = parse( expr );
+        // grain 为 0 时每个非叶节点都拆成任务，最大程度地检验调度
+        ParallelOptions exact{ Reassociation::EXACT, 0, &workers };
+        EXPECT_EQ( evaluateParallel( *ast, exact ), ast->evaluate() ) << expr;
+
+        ParallelOptions balanced{ Reassociation::BALANCED, 0, &serial };
+        double reference = evaluateParallel( *ast, balanced );
+        EXPECT_NEAR( reference, ast->evaluate(), 1e-9 * std::abs( ast->evaluate() ) + 1e-12 ) << expr;
+        balanced.pool = &workers;
+        EXPECT_EQ( evaluateParallel( *ast, balanced ), reference ) << expr;
+    }
+
+    // 同一优先级的左深链条压平为一个节点；/ 使整条链只能按顺序合并
+    auto mixed = parse( "1+2-3+4*5*6/7" );
+    ParallelEvaluator evaluator( *mixed, { Reassociation::BALANCED, 0, &workers } );
+    EXPECT_EQ( evaluator.chains(), 2 );
+    EXPECT_EQ( evaluator.longestChain(), 4 );
+    EXPECT_DOUBLE_EQ( evaluator.evaluate(), 1 + 2 - 3 + 4.0 * 5 * 6 / 7 );
+
+    auto broken = parse( chain + "+1/(x-x)" );
+    EXPECT_THROW( static_cast< void >( evaluateParallel( *broken, { Reassociation::BALANCED, 0, &workers } ) ),
+                  std::runtime_error );
+}
+
+// 几十万项的链条：建立计划、求值和析构都不能递归整条链
+TEST( ParallelTest, MillionNodeChain ) {
+    std::string expr = "0";
+    for ( int i = 1; i <= 300000; ++i )
+        expr += "+" + std::to_string( i % 1000 ) + "*2";
+    Lexer lexer( expr );
+    Parser parser( lexer );
+    auto ast = parser.parse();
+
+    ThreadPool workers( 4 );
+    ParallelEvaluator evaluator( *ast, { Reassociation::BALANCED, 2e4, &workers } );
+    EXPECT_EQ( evaluator.longestChain(), 300001 );
+    EXPECT_GT( evaluator.nodes(), 900000 );
+    // 每一项都是偶数的整数，任意合并顺序都是精确的
+    EXPECT_EQ( evaluator.evaluate(), 2.0 * 300 * ( 999 * 1000 / 2 ) );
+    EXPECT_EQ( evaluateParallel( *ast, { Reassociation::EXACT, 2e4, &workers } ), evaluator.evaluate() );
+}
+
+TEST( BundleTest, MapsAndEvaluatesFormulas ) {
+    BundleWriter writer;
+    writer.add( "area", "pi * r ^ 2" );
+    writer.add( "hyp", "sqrt(a^2 + b^2)" );
+    writer.add( "folded", "2 * (3 + 4)! / 7 + x" );
+    writer.add( "inv", "1 / (x - 1)" );
+    EXPECT_THROW( writer.add( "area", "1" ), std::runtime_error );
+    EXPECT_THROW( writer.add( "bad", "1 +" ), std::runtime_error );
+    // 聚合依赖进程内的数组，不能写入
+    std::vector< double > v{ 1, 2 };
+    ArrayBindings arrays;
+    arrays.bind( "v", v );
+    Lexer lexer( "sum(v)" );
+    Parser parser( lexer, arrays.resolver() );
+    EXPECT_THROW( writer.add( "agg", compileBatch( *parser.parse() ) ), std::runtime_error );
+
+    auto path = std::filesystem::temp_directory_path() / "simple_calculator_test.bundle";
+    writer.write( path.string() );
+    {
+        auto bundle = FormulaBundle::open( path.string(), BundleCheck::FULL );
+        ASSERT_EQ( bundle.size(), 4 );
+        EXPECT_FALSE( bundle.find( "missing" ) );
+
+        auto hyp = bundle.find( "hyp" );
+        ASSERT_TRUE( hyp );
+        ASSERT_EQ( hyp->columnCount(), 2 );
+        EXPECT_EQ( hyp->column( 0 ), "a" );
+        EXPECT_DOUBLE_EQ( ( *hyp )( std::vector< double >{ 3, 4 } ), 5 );
+        EXPECT_DOUBLE_EQ( ( *bundle.find( "area" ) )( std::vector< double >{ 2 } ), 4 * std::numbers::pi );
+
+        // 常量部分折叠为一条指令
+        auto folded = bundle.find( "folded" );
+        EXPECT_EQ( folded->program().code.size(), 3 );
+        EXPECT_DOUBLE_EQ( ( *folded )( std::vector< double >{ 1 } ), 1441 );
+
+        std::vector< double > xs{ 0, 1, 3 }, out( 3 );
+        std::vector< EvalStatus > status( 3 );
+        Column column{ xs.data() };
+        bundle.find( "inv" )->evaluate( std::span( &column, 1 ), 0, 3, out.data(), status.data() );
+        EXPECT_DOUBLE_EQ( out[ 0 ], -1 );
+        EXPECT_EQ( status[ 1 ], EvalStatus::DIVISION_BY_ZERO );
+        EXPECT_DOUBLE_EQ( out[ 2 ], 0.5 );
+    }
+
+    // 任何一个字节损坏都会在 FULL 校验时被发现
+    auto bytes = writer.serialize();
+    EXPECT_EQ( FormulaBundle::view( bytes ).size(), 4 );
+    for ( std::size_t i = 0; i < bytes.size(); i += 7 ) {
+        auto damaged = bytes;
+        damaged[ i ] ^= std::byte{ 0x20 };
+        EXPECT_THROW( static_cast< void >( FormulaBundle::view( damaged, BundleCheck::FULL ) ), std::runtime_error )
+            << "byte " << i;
+    }
+    // 默认的 INDEX 校验不读指令段，损坏的指令在公式第一次被取出时才发现，其他公式不受影响
+    {
+        auto code    = FormulaBundle::view( bytes ).find( "area" )->program().code;
+        auto damaged = bytes;
+        damaged[ static_cast< std::size_t >( reinterpret_cast< const std::byte* >( &code[ 1 ] ) - bytes.data() ) ] =
+            std::byte{ 0xff };
+        auto bundle = FormulaBundle::view( damaged );
+        EXPECT_THROW( static_cast< void >( bundle.find( "area" ) ), std::runtime_error );
+        EXPECT_DOUBLE_EQ( ( *bundle.find( "hyp" ) )( std::vector< double >{ 3, 4 } ), 5 );
+    }
+    bytes.pop_back();
+    EXPECT_THROW( static_cast< void >( FormulaBundle::view( bytes ) ), std::runtime_error );
+    std::filesystem::remove( path );
+}
+
+TEST( IngestTest, StreamsCsvAndColumnFiles ) {
+    auto dir = std::filesystem::temp_directory_path();
+    auto csv = ( dir / "simple_calculator_ingest.csv" ).string();
+    auto out = ( dir / "simple_calculator_ingest.out" ).string();
+    {
+        std::ofstream file( csv );
+        file << "id, label ,x,y\r\n";
+        for ( int i = 0; i < 1000; ++i )
+            file << i << ",\"row\"," << i * 0.5 << "," << ( i % 10 ) << "\r\n";
+        file << "\n1000,short,2\n";
+    }
+    // 块很小，流水线要交替使用两组缓冲区很多次
+    StreamOptions options{ .chunkRows = 64, .output = OutputFormat::TEXT };
+    auto stats = evaluateCsv( "x / y + 1", CsvInput{ csv }, out, options );
+    EXPECT_EQ( stats.rows, 1001 );
+    EXPECT_EQ( stats.chunks, 16 );
+    EXPECT_EQ( stats.errors, 100 );  // y == 0
+    {
+        std::ifstream file( out );
+        std::vector< std::string > lines;
+        for ( std::string line; std::getline( file, line ); )
+            lines.push_back( line );
+        ASSERT_EQ( lines.size(), 1001 );
+        EXPECT_EQ( lines[ 0 ], "nan" );
+        EXPECT_DOUBLE_EQ( std::stod( lines[ 13 ] ), 13 * 0.5 / 3 + 1 );
+        EXPECT_EQ( lines[ 1000 ], "nan" );  // 缺少 y
+    }
+    EXPECT_THROW( evaluateCsv( "z + 1", CsvInput{ csv }, out ), std::runtime_error );
+    EXPECT_THROW( evaluateCsv( "label", CsvInput{ csv }, out ), std::runtime_error );
+    // 缓冲区大小只取决于块大小和列数，与数据量无关
+    auto large = stats.bufferBytes;
+    std::ofstream( csv ) << "x,y\n1,2\n";
+    stats = evaluateCsv( "x / y + 1", CsvInput{ csv }, out, options );
+    EXPECT_EQ( stats.rows, 1 );
+    EXPECT_EQ( stats.bufferBytes, large );
+
+    // 原始列文件直接在映射的内存上求值
+    std::vector< double > xs( 100000 ), ys( 100000 );
+    for ( std::size_t i = 0; i < xs.size(); ++i ) {
+        xs[ i ] = static_cast< double >( i );
+        ys[ i ] = std::sqrt( xs[ i ] );
+    }
+    auto xPath = ( dir / "simple_calculator_ingest.x" ).string();
+    auto yPath = ( dir / "simple_calculator_ingest.y" ).string();
+    std::ofstream( xPath, std::ios::binary ).write( reinterpret_cast< const char* >( xs.data() ), 800000 );
+    std::ofstream( yPath, std::ios::binary ).write( reinterpret_cast< const char* >( ys.data() ), 800000 );
+    ColumnFilesInput columns{ { { "x", xPath }, { "y", yPath } } };
+    stats = evaluateColumnFiles( "y * y - x", columns, out, StreamOptions{ .chunkRows = 4096 } );
+    EXPECT_EQ( stats.rows, 100000 );
+    EXPECT_EQ( stats.errors, 0 );
+    std::vector< double > results( 100000 );
+    std::ifstream( out, std::ios::binary ).read( reinterpret_cast< char* >( results.data() ), 800000 );
+    for ( std::size_t i = 0; i < results.size(); i += 997 )
+        EXPECT_NEAR( results[ i ], 0, 1e-9 * xs[ i ] );
+
+    for ( const auto& path : { csv, out, xPath, yPath } )
+        std::filesystem::remove( path );
+}
+
+TEST( NumericTest, SolveWithBrent ) {
+    auto root = solve( "x^2 - 2", "x", { 0, 2 } );
+    EXPECT_TRUE( root.converged );
+    EXPECT_NEAR( root.root, sqrt( 2 ), 1e-12 );
+    // 超线性收敛，远少于二分法所需的约 40 次
+    EXPECT_LT( root.evaluations, 20 );
+
+    auto cosine = solve( "cos(t) - t", "t", { 0, 1 } );
+    EXPECT_NEAR( cosine.root, 0.7390851332151607, 1e-12 );
+    EXPECT_THROW( solve( "x^2 + 1", "x", { -1, 1 } ), std::runtime_error );
+}
+
+TEST( NumericTest, IntegrateWithGaussKronrod ) {
+    auto sine = integrate( "sin(x)", "x", 0, std::numbers::pi );
+    EXPECT_TRUE( sine.converged );
+    EXPECT_NEAR( sine.value, 2, 1e-10 );
+    EXPECT_EQ( sine.evaluations % 15, 0 );
+    EXPECT_LT( sine.evaluations, 200 );
+
+    // 端点处导数发散，需要自适应细分
+    auto root = integrate( "sqrt(x)", "x", 0, 1, 1e-8 );
+    EXPECT_TRUE( root.converged );
+    EXPECT_NEAR( root.value, 2.0 / 3, 1e-8 );
+    EXPECT_GT( root.intervals, 1 );
+
+    auto gauss = integrate( "e^(-(x^2))", "x", -10, 10 );
+    EXPECT_NEAR( gauss.value, sqrt( std::numbers::pi ), 1e-9 );
+
+    // 发散的被积函数在达到区间上限后停止
+    UnivariateFunction blowup( "1/x", "x" );
+    auto diverging = integrate( blowup, 0, 1, 1e-10, 64 );
+    EXPECT_FALSE( diverging.converged );
+    EXPECT_LE( diverging.intervals, 64 );
+}
+
+TEST( NumericTest, UnivariateFunctionWithArrays ) {
+    std::vector< double > weights{ 1, 2, 3 };
+    ArrayBindings arrays;
+    arrays.bind( "w", weights );
+    UnivariateFunction f( "x * sum(w)", "x", arrays.resolver() );
+    EXPECT_EQ( f( 2 ), 12 );
+    EXPECT_EQ( f.evaluations(), 1 );
+    // 聚合体依赖批量变量时不能按标量广播
+    EXPECT_THROW( UnivariateFunction( "sum(w * x)", "x", arrays.resolver() ), std::runtime_error );
+}
+
+TEST( PlotSamplerTest, AdaptiveRefinement ) {
+    PlotViewport viewport{ .xmin = -10, .xmax = 10, .ymin = -2, .ymax = 2, .width = 400, .height = 200 };
+    PlotSampler line( "2*x+1" );
+    auto columns = line.sample( viewport );
+    ASSERT_EQ( columns.size(), 400 );
+    // 直线无需细分，只采样粗网格(间距为 2~4 像素)
+    EXPECT_EQ( line.stats().rounds, 0 );
+    EXPECT_LE( line.stats().evaluations, 203 );
+
+    PlotSampler wave( "sin(x^2)" );
+    wave.sample( viewport );
+    // 高频区域需要细分
+    EXPECT_GT( wave.stats().rounds, 0 );
+    EXPECT_GT( wave.stats().evaluations, 150 );
+}
+
+TEST( PlotSamplerTest, MinMaxDecimationAndBreaks ) {
+    PlotViewport viewport{ .xmin = -3, .xmax = 3, .ymin = -5, .ymax = 5, .width = 300, .height = 200 };
+    PlotSampler tangent( "tan(x)" );
+    auto columns = tangent.sample( viewport );
+    // tan 在 ±pi/2 处的极点不能连线
+    std::size_t breaks = 0;
+    for ( const auto& column : columns ) {
+        if ( column.samples > 0 && column.breakBefore )
+            ++breaks;
+        EXPECT_LE( column.min, column.max );
+    }
+    EXPECT_EQ( breaks, 2 );
+
+    PlotSampler root( "sqrt(x)" );
+    columns = root.sample( viewport );
+    // 负半轴无定义
+    EXPECT_EQ( columns[ 10 ].samples, 0 );
+    EXPECT_GT( columns[ 200 ].samples, 0 );
+    EXPECT_NEAR( columns[ 200 ].first, sqrt( -3 + 200 * 0.02 ), 0.02 );
+}
+
+TEST( PlotSamplerTest, IncrementalPan ) {
+    PlotViewport viewport{ .xmin = 0, .xmax = 20, .ymin = -2, .ymax = 2, .width = 400, .height = 200 };
+    PlotSampler sampler( "sin(x)" );
+    sampler.sample( viewport );
+    std::size_t full = sampler.stats().evaluations;
+    // 平移四分之一屏只需要补充新露出的部分
+    viewport.xmin += 5;
+    viewport.xmax += 5;
+    sampler.sample( viewport );
+    EXPECT_LT( sampler.stats().evaluations, full / 2 );
+    // 回到原位置不需要任何新的求值
+    viewport.xmin -= 5;
+    viewport.xmax -= 5;
+    sampler.sample( viewport );
+    EXPECT_EQ( sampler.stats().evaluations, 0 );
+}
+
+TEST( InstrumentationTest, CountsPhasesAndNodes ) {
+    instrumentation::reset();
+    Lexer lexer( "1+2*3" );
+    Parser parser( lexer );
+    auto ast = parser.parse();
+    EXPECT_DOUBLE_EQ( ast->evaluate(), 7 );
+
+    auto stats = instrumentation::snapshot();
+    if constexpr ( !instrumentation::enabled() ) {
+        // 未启用时宏展开为空，不记录任何数据
+        EXPECT_EQ( stats.tokens, 0 );
+        EXPECT_EQ( stats.phase( instrumentation::Phase::EVALUATE ).calls, 0 );
+        return;
+    }
+    // 1 + 2 * 3 END
+    EXPECT_EQ( stats.tokens, 6 );
+    EXPECT_EQ( stats.nodesBuilt, 5 );
+    EXPECT_EQ( stats.phase( instrumentation::Phase::PARSE ).calls, 1 );
+    EXPECT_EQ( stats.phase( instrumentation::Phase::EVALUATE ).calls, 1 );
+    EXPECT_EQ( stats.node( instrumentation::NodeKind::NUMBER ).evaluations, 3 );
+    EXPECT_EQ( stats.node( instrumentation::NodeKind::MULTIPLY ).evaluations, 1 );
+    const auto& add = stats.node( instrumentation::NodeKind::ADD );
+    EXPECT_LE( add.selfNanoseconds, add.totalNanoseconds );
+
+    std::ostringstream trace;
+    instrumentation::writeChromeTrace( trace );
+    EXPECT_NE( trace.str().find( "\"name\":\"parse\"" ), std::string::npos );
+    EXPECT_NE( trace.str().find( "AddNode" ), std::string::npos );
+}